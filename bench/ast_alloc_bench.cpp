@@ -0,0 +1,79 @@
+// Counts heap allocations made while lexing, parsing and tearing down the AST
+// of a large generated program.
+//
+//   cat_ast_alloc_bench [functions]
+#include "lexer.h"
+#include "parser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static size_t allocCount = 0;
+
+void* operator new(std::size_t size) {
+    ++allocCount;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) std::abort();
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static std::string generateSource(int functions) {
+    std::string src;
+    for (int i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        src += "fn f" + n + "(int a, int b) -> int {\n";
+        src += "    int x = a + b + " + n + ";\n";
+        src += "    int y = x + 1;\n";
+        src += "    if (x < y && a != b) {\n";
+        src += "        print(\"value: \", x + y);\n";
+        src += "    } else {\n";
+        src += "        print(x);\n";
+        src += "    }\n";
+        src += "    while (x <= 10) {\n";
+        src += "        print(x + y + a + b);\n";
+        src += "    }\n";
+        src += "    return f" + n + "(x, y) + x;\n";
+        src += "}\n\n";
+    }
+    return src;
+}
+
+int main(int argc, char* argv[]) {
+    int functions = argc > 1 ? std::atoi(argv[1]) : 20000;
+    std::string source = generateSource(functions);
+
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    // Lexing alone, materializing every token for comparison
+    size_t before = allocCount;
+    auto t0 = clock::now();
+    SymbolTable lexSymbols;
+    size_t tokenCount = Lexer(source, lexSymbols).tokenize().size();
+    auto t1 = clock::now();
+    size_t lexAllocs = allocCount - before;
+
+    // The parser pulls tokens from the lexer as it goes
+    before = allocCount;
+    auto t2 = clock::now();
+    SymbolTable symbols;
+    Lexer lexer(source, symbols);
+    auto ast = Parser(lexer).parse();
+    auto t3 = clock::now();
+    size_t parseAllocs = allocCount - before;
+
+    auto t4 = clock::now();
+    ast.reset();
+    auto t5 = clock::now();
+
+    std::printf("source: %d functions, %zu bytes, %zu tokens (%zu bytes if materialized), %zu symbols\n", functions,
+                source.size(), tokenCount, tokenCount * sizeof(Token), symbols.size());
+    std::printf("lex only:  %10zu allocations %8.2f ms\n", lexAllocs, ms(t1 - t0));
+    std::printf("lex+parse: %10zu allocations %8.2f ms\n", parseAllocs, ms(t3 - t2));
+    std::printf("teardown:  %21s %8.2f ms\n", "", ms(t5 - t4));
+    return 0;
+}
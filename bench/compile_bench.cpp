@@ -0,0 +1,292 @@
+// Measures lexer, parser and code generator throughput in lines/s over a
+// synthetic program, along with the peak RSS reached after each phase.
+// Programs come from a seeded generator, so the same options always produce
+// the same source (its hash is printed) and timings are the best of several
+// repetitions.
+//
+//   cat_compile_bench [--shape=mixed|functions|expressions|loops|strings]
+//                     [--size=N] [--depth=N] [--seed=N] [--repetitions=N]
+//                     [-O0..-O3] [--emit-source=file]
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Small deterministic PRNG, so sources don't depend on the standard library.
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed * 2862933555777941757ull + 3037000493ull) {}
+    uint32_t next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<uint32_t>(state >> 33);
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+struct Options {
+    std::string shape = "mixed";
+    int size = 2000;
+    int depth = 12;
+    uint64_t seed = 1;
+    int repetitions = 5;
+    unsigned optLevel = 0;
+    std::string emitSource;
+};
+
+class Generator {
+public:
+    Generator(const Options& options) : opts(options), rng(options.seed) {}
+
+    std::string run() {
+        for (int i = 0; i < opts.size; ++i) {
+            const std::string& shape = opts.shape == "mixed" ? Shapes[rng.below(4)] : opts.shape;
+            if (shape == "expressions") expressionFunction(i);
+            else if (shape == "loops") loopFunction(i);
+            else if (shape == "strings") stringFunction(i);
+            else smallFunction(i);
+        }
+        src += "fn main() -> int {\n    print(f0(1, 2));\n    return 0;\n}\n";
+        return std::move(src);
+    }
+
+private:
+    static inline const std::string Shapes[] = {"functions", "expressions", "loops", "strings"};
+
+    // Every generated function has the same signature, so any earlier one
+    // can be called from a later one.
+    void header(int i) { src += "fn f" + std::to_string(i) + "(int a, int b) -> int {\n"; }
+
+    std::string operand(int fn) {
+        switch (rng.below(fn > 0 ? 5 : 4)) {
+            case 0: return "a";
+            case 1: return "b";
+            case 2: return "x";
+            case 3: return std::to_string(rng.below(1000));
+            default: return "f" + std::to_string(rng.below(fn)) + "(a, x)";
+        }
+    }
+
+    std::string expression(int fn, int depth) {
+        if (depth == 0) return operand(fn);
+        static const char* const ops[] = {" + ", " - ", " * ", " / "};
+        return "(" + expression(fn, depth - 1) + ops[rng.below(4)] + expression(fn, rng.below(depth)) + ")";
+    }
+
+    std::string condition(int fn) {
+        static const char* const cmps[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+        return operand(fn) + cmps[rng.below(6)] + operand(fn);
+    }
+
+    void smallFunction(int i) {
+        header(i);
+        src += "    int x = a + b + " + std::to_string(i) + ";\n";
+        src += "    if (" + condition(i) + " && " + condition(i) + ") {\n";
+        src += "        print(\"%d\\n\", x);\n";
+        src += "    } else {\n";
+        src += "        print(x * 2);\n";
+        src += "    }\n";
+        src += "    return " + operand(i) + " + x;\n}\n\n";
+    }
+
+    void expressionFunction(int i) {
+        header(i);
+        src += "    int x = a - b;\n";
+        src += "    int y = " + expression(i, opts.depth / 2) + ";\n";
+        src += "    return " + expression(i, opts.depth) + " + y;\n}\n\n";
+    }
+
+    void loopFunction(int i) {
+        header(i);
+        src += "    int x = a;\n";
+        std::string indent = "    ";
+        int nesting = 1 + rng.below(3);
+        for (int n = 0; n < nesting; ++n) {
+            src += indent + "while (" + condition(i) + ") {\n";
+            indent += "    ";
+        }
+        for (int s = 0, e = 8 + rng.below(16); s < e; ++s) {
+            src += indent + "int t" + std::to_string(s) + " = " + expression(i, 2) + ";\n";
+            src += indent + "print(\"%d\\n\", t" + std::to_string(s) + ");\n";
+        }
+        for (int n = 0; n < nesting; ++n) {
+            indent.resize(indent.size() - 4);
+            src += indent + "}\n";
+        }
+        src += "    return x;\n}\n\n";
+    }
+
+    void stringFunction(int i) {
+        static const char* const words[] = {"compile", "token", "parser", "module", "value", "string", "the",
+                                            "literal", "benchmark", "output", "escape", "line"};
+        header(i);
+        src += "    int x = b;\n";
+        for (int s = 0, e = 4 + rng.below(8); s < e; ++s) {
+            std::string text;
+            for (int w = 0, n = 8 + rng.below(24); w < n; ++w) {
+                text += words[rng.below(12)];
+                text += w + 1 < n ? " " : "";
+            }
+            src += "    print(\"" + text + ": %d\\t%d\\n\", a, x);\n";
+        }
+        src += "    return x;\n}\n\n";
+    }
+
+    const Options& opts;
+    Random rng;
+    std::string src;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Runs fn repetitions times and returns the best wall time in seconds.
+template <typename Fn>
+double best(int repetitions, Fn&& fn) {
+    double result = 1e300;
+    for (int r = 0; r < repetitions; ++r) {
+        auto t0 = Clock::now();
+        fn();
+        result = std::min(result, std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    return result;
+}
+
+double peakRSSMB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // kilobytes on Linux
+}
+
+uint64_t fnv1a(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        h = (h ^ c) * 1099511628211ull;
+    }
+    return h;
+}
+
+bool parseArgs(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        auto value = [arg](const char* name) -> const char* {
+            size_t n = std::strlen(name);
+            return std::strncmp(arg, name, n) == 0 ? arg + n : nullptr;
+        };
+        if (const char* v = value("--shape=")) opts.shape = v;
+        else if (const char* v = value("--size=")) opts.size = std::atoi(v);
+        else if (const char* v = value("--depth=")) opts.depth = std::atoi(v);
+        else if (const char* v = value("--seed=")) opts.seed = std::strtoull(v, nullptr, 10);
+        else if (const char* v = value("--repetitions=")) opts.repetitions = std::atoi(v);
+        else if (const char* v = value("--emit-source=")) opts.emitSource = v;
+        else if (std::strlen(arg) == 3 && value("-O") && arg[2] >= '0' && arg[2] <= '3') opts.optLevel = arg[2] - '0';
+        else {
+            std::fprintf(stderr, "Unknown argument: %s\n", arg);
+            return false;
+        }
+    }
+    if (opts.shape != "mixed" && opts.shape != "functions" && opts.shape != "expressions" &&
+        opts.shape != "loops" && opts.shape != "strings") {
+        std::fprintf(stderr, "Unknown shape: %s\n", opts.shape.c_str());
+        return false;
+    }
+    if (opts.size < 1 || opts.depth < 1 || opts.repetitions < 1) {
+        std::fprintf(stderr, "--size, --depth and --repetitions must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+void report(const char* phase, double secs, size_t lines, size_t bytes) {
+    std::printf("%-10s %10.2f ms %12.0f lines/s %9.1f MB/s   peak RSS %8.1f MB\n", phase, secs * 1e3,
+                lines / secs, bytes / secs / (1024.0 * 1024.0), peakRSSMB());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        return 1;
+    }
+
+    std::string source = Generator(opts).run();
+    size_t lines = std::count(source.begin(), source.end(), '\n');
+    if (!opts.emitSource.empty()) {
+        FILE* out = std::fopen(opts.emitSource.c_str(), "wb");
+        if (!out || std::fwrite(source.data(), 1, source.size(), out) != source.size()) {
+            std::fprintf(stderr, "Could not write %s\n", opts.emitSource.c_str());
+            return 1;
+        }
+        std::fclose(out);
+    }
+
+    std::printf("shape %s, size %d, depth %d, seed %llu, -O%u, best of %d\n", opts.shape.c_str(), opts.size,
+                opts.depth, (unsigned long long)opts.seed, opts.optLevel, opts.repetitions);
+    std::printf("source: %zu lines, %.2f MB, hash %016llx\n", lines, source.size() / (1024.0 * 1024.0),
+                (unsigned long long)fnv1a(source));
+    std::printf("baseline peak RSS %.1f MB\n\n", peakRSSMB());
+
+    // Phases run in pipeline order, so each peak RSS includes the phases
+    // before it.
+    size_t tokens = 0;
+    double lexSecs = best(opts.repetitions, [&] {
+        SymbolTable symbols;
+        Lexer lexer(source, symbols);
+        while (lexer.next().type != TokenType::END_OF_FILE) {}
+        tokens = lexer.tokenCount();
+    });
+    report("lexer", lexSecs, lines, source.size());
+
+    // The parser pulls its tokens from the lexer, so its own share is the
+    // difference to lexing alone.
+    SymbolTable symbols;
+    std::unique_ptr<ModuleAST> ast;
+    double parseSecs = best(opts.repetitions, [&] {
+        SymbolTable runSymbols;
+        Lexer lexer(source, runSymbols);
+        Parser parser(lexer);
+        if (!parser.parse()) {
+            std::fprintf(stderr, "Generated program failed to parse\n");
+            std::exit(1);
+        }
+    });
+    report("lex+parse", parseSecs, lines, source.size());
+    report("parser", std::max(parseSecs - lexSecs, 1e-9), lines, source.size());
+
+    Lexer lexer(source, symbols);
+    Parser parser(lexer);
+    ast = parser.parse();
+    size_t nodes = ast->Nodes.objectCount();
+
+    size_t instructions = 0;
+    double codegenSecs = best(opts.repetitions, [&] {
+        CodeGen codegen;
+        codegen.generate(*ast);
+        instructions = codegen.instructionCount();
+    });
+    report("codegen", codegenSecs, lines, source.size());
+
+    if (opts.optLevel > 0) {
+        // Only the pipeline is timed; generation was measured above.
+        double optSecs = 1e300;
+        for (int r = 0; r < opts.repetitions; ++r) {
+            CodeGen codegen;
+            codegen.generate(*ast);
+            auto t0 = Clock::now();
+            codegen.optimize(opts.optLevel);
+            optSecs = std::min(optSecs, std::chrono::duration<double>(Clock::now() - t0).count());
+        }
+        report("optimize", optSecs, lines, source.size());
+    }
+
+    std::printf("\n%zu tokens, %zu AST nodes, %zu IR instructions\n", tokens, nodes, instructions);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Measures lexer throughput in MB/s over a generated program with long
+// identifiers, indentation, comments and string literals.
+//
+//   cat_lexer_bench [functions] [repetitions]
+#include "lexer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static std::string generateSource(int functions) {
+    std::string src;
+    for (int i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        src += "// Function number " + n + " of the generated lexer benchmark input.\n";
+        src += "fn compute_running_total_" + n + "(int first_operand, int second_operand) -> int {\n";
+        src += "    int accumulated_value_" + n + " = first_operand + second_operand + 1234567;\n";
+        src += "    float scaled_fraction = 3.14159 + 2.71828;\n";
+        src += "    // Compare the operands and report the larger one to the user.\n";
+        src += "    if (first_operand <= second_operand && accumulated_value_" + n + " != 0) {\n";
+        src += "        print(\"the second operand is at least as large as the first one\\n\");\n";
+        src += "    } else {\n";
+        src += "        print(\"the first operand is larger than the second one\\n\");\n";
+        src += "    }\n";
+        src += "    return accumulated_value_" + n + ";\n";
+        src += "}\n\n";
+    }
+    return src;
+}
+
+int main(int argc, char* argv[]) {
+    int functions = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::string source = generateSource(functions);
+
+    using clock = std::chrono::steady_clock;
+    double best = 1e300;
+    size_t tokens = 0;
+    for (int r = 0; r < repetitions; ++r) {
+        SymbolTable symbols;
+        Lexer lexer(source, symbols);
+        tokens = 0;
+        auto t0 = clock::now();
+        while (lexer.next().type != TokenType::END_OF_FILE) {
+            tokens++;
+        }
+        double secs = std::chrono::duration<double>(clock::now() - t0).count();
+        if (secs < best) best = secs;
+    }
+
+    double mb = source.size() / (1024.0 * 1024.0);
+    std::printf("source: %.2f MB, %zu tokens\n", mb, tokens);
+    std::printf("lexer:  %.2f ms best of %d, %.1f MB/s, %.1f Mtokens/s\n", best * 1e3, repetitions, mb / best,
+                tokens / best / 1e6);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for AST nodes and their strings. Memory is handed out from
+// large slabs and released all at once when the arena is destroyed, so only
+// trivially destructible types may live in it.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+        if (cur && pad + size <= size_t(end - cur)) {
+            char* p = cur + pad;
+            cur = p + size;
+            return p;
+        }
+        return allocateSlow(size, align);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        ++objects;
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    std::span<T> copyArray(std::span<const T> items) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        if (items.empty()) return {};
+        T* data = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+        std::uninitialized_copy(items.begin(), items.end(), data);
+        return {data, items.size()};
+    }
+
+    std::string_view copyString(std::string_view s) {
+        if (s.empty()) return {};
+        char* data = static_cast<char*>(allocate(s.size(), 1));
+        std::memcpy(data, s.data(), s.size());
+        return {data, s.size()};
+    }
+
+    size_t bytesReserved() const { return reserved; }
+    // Number of objects created with make(), i.e. AST nodes for a module.
+    size_t objectCount() const { return objects; }
+
+private:
+    static constexpr size_t SlabSize = 64 * 1024;
+
+    void* allocateSlow(size_t size, size_t align);
+
+    std::vector<std::unique_ptr<char[]>> slabs;
+    char* cur = nullptr;
+    char* end = nullptr;
+    size_t reserved = 0;
+    size_t objects = 0;
+};
+
+#endif
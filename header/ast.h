@@ -1,103 +1,152 @@
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
+#include "symbol.h"
 #include "token.h"
-#include <memory>
-#include <string>
+#include <span>
+#include <string_view>
+#include <utility>
 #include <vector>
-#include <map>
+
+// All nodes are allocated from the Arena owned by their ModuleAST. Children
+// are plain pointers, lists are spans into the arena and strings view arena
+// or static memory, so the whole tree is released at once with the module.
+// Identifiers are Symbols of the SymbolTable used to lex the module, which
+// must outlive it.
+
+// Operators, mapped from their tokens by the parser
+enum class BinaryOp : uint8_t {
+    Add, Sub, Mul, Div,
+    Less, Greater, LessEqual, GreaterEqual, Equal, NotEqual,
+    And, Or
+};
+enum class UnaryOp : uint8_t { Not, Neg };
+
+// Node kinds, used by ASTVisitor to dispatch without RTTI
+enum class ExprKind { Number, String, Bool, Variable, Binary, Unary, Call, Index, Vector };
+enum class StmtKind { Block, Return, Print, Expr, Scan, VarDecl, If, While, Assign, For };
 
 // Base class for all expression nodes
 struct Expr {
-    virtual ~Expr() = default;
+    const ExprKind Kind;
+    explicit Expr(ExprKind kind) : Kind(kind) {}
 };
 
 // Base class for all statement nodes
 struct Stmt {
-    virtual ~Stmt() = default;
+    const StmtKind Kind;
+    explicit Stmt(StmtKind kind) : Kind(kind) {}
 };
 
-// Expression for a number literal
+// Expression for a number literal, converted once by the parser
 struct NumberExpr : Expr {
-    std::string Value;
-    TokenType Type;
-    NumberExpr(const std::string& value, TokenType type) : Value(value), Type(type) {}
+    TokenType Type; // INT_LITERAL or FLOAT_LITERAL
+    int32_t IntValue = 0;
+    float FloatValue = 0;
+    explicit NumberExpr(int32_t value) : Expr(ExprKind::Number), Type(TokenType::INT_LITERAL), IntValue(value) {}
+    explicit NumberExpr(float value) : Expr(ExprKind::Number), Type(TokenType::FLOAT_LITERAL), FloatValue(value) {}
 };
 
 // Expression for a string literal
 struct StringExpr : Expr {
-    std::string Value;
-    StringExpr(const std::string& value) : Value(value) {}
+    std::string_view Value;
+    StringExpr(std::string_view value) : Expr(ExprKind::String), Value(value) {}
 };
 
 // Expression for a boolean literal
 struct BoolExpr : Expr {
     bool Value;
-    BoolExpr(bool value) : Value(value) {}
+    BoolExpr(bool value) : Expr(ExprKind::Bool), Value(value) {}
 };
 
 // Expression for a variable
 struct VariableExpr : Expr {
-    std::string Name;
-    VariableExpr(const std::string& name) : Name(name) {}
+    Symbol Name;
+    VariableExpr(Symbol name) : Expr(ExprKind::Variable), Name(name) {}
 };
 
 // Expression for a binary operation
 struct BinaryExpr : Expr {
-    std::string Op;
-    std::unique_ptr<Expr> LHS, RHS;
-    BinaryExpr(const std::string& op, std::unique_ptr<Expr> lhs, std::unique_ptr<Expr> rhs)
-        : Op(op), LHS(std::move(lhs)), RHS(std::move(rhs)) {}
+    BinaryOp Op;
+    Expr* LHS;
+    Expr* RHS;
+    BinaryExpr(BinaryOp op, Expr* lhs, Expr* rhs)
+        : Expr(ExprKind::Binary), Op(op), LHS(lhs), RHS(rhs) {}
 };
 
 // Expression for a unary operation
 struct UnaryExpr : Expr {
-    std::string Op;
-    std::unique_ptr<Expr> RHS;
-    UnaryExpr(const std::string& op, std::unique_ptr<Expr> rhs)
-        : Op(op), RHS(std::move(rhs)) {}
+    UnaryOp Op;
+    Expr* RHS;
+    UnaryExpr(UnaryOp op, Expr* rhs)
+        : Expr(ExprKind::Unary), Op(op), RHS(rhs) {}
 };
 
 // Expression for a function call
 struct CallExpr : Expr {
-    std::string Callee;
-    std::vector<std::unique_ptr<Expr>> Args;
-    CallExpr(const std::string& callee, std::vector<std::unique_ptr<Expr>> args)
-        : Callee(callee), Args(std::move(args)) {}
+    Symbol Callee;
+    std::span<Expr*> Args;
+    CallExpr(Symbol callee, std::span<Expr*> args)
+        : Expr(ExprKind::Call), Callee(callee), Args(args) {}
+};
+
+// Expression building a vector from one value per lane, or from a single
+// value copied to every lane: float4(1.0, 2.0, 3.0, 4.0), int8(0)
+struct VectorExpr : Expr {
+    std::string_view Type;
+    std::span<Expr*> Lanes;
+    VectorExpr(std::string_view type, std::span<Expr*> lanes) : Expr(ExprKind::Vector), Type(type), Lanes(lanes) {}
+};
+
+// Expression for an array element or a vector lane, a[i]
+struct IndexExpr : Expr {
+    VariableExpr* Array;
+    Expr* Index;
+    IndexExpr(VariableExpr* array, Expr* index) : Expr(ExprKind::Index), Array(array), Index(index) {}
 };
 
-// Statement for a variable declaration
+// Statement for a variable declaration. Arrays have an element count
+// instead of an initializer and start out zeroed.
 struct VarDeclStmt : Stmt {
-    std::string VarType;
-    std::string VarName;
-    std::unique_ptr<Expr> Init;
-    VarDeclStmt(const std::string& type, const std::string& name, std::unique_ptr<Expr> init)
-        : VarType(type), VarName(name), Init(std::move(init)) {}
+    std::string_view VarType; // element type for arrays
+    Symbol VarName;
+    Expr* Init; // Can be nullptr
+    Expr* ArraySize; // nullptr unless the variable is an array
+    VarDeclStmt(std::string_view type, Symbol name, Expr* init, Expr* arraySize = nullptr)
+        : Stmt(StmtKind::VarDecl), VarType(type), VarName(name), Init(init), ArraySize(arraySize) {}
+};
+
+// Statement for an assignment to a variable or an array element
+struct AssignStmt : Stmt {
+    Expr* Target; // VariableExpr or IndexExpr
+    Expr* Value;
+    AssignStmt(Expr* target, Expr* value) : Stmt(StmtKind::Assign), Target(target), Value(value) {}
 };
 
 // Statement for a return
 struct ReturnStmt : Stmt {
-    std::unique_ptr<Expr> Value;
-    ReturnStmt(std::unique_ptr<Expr> value) : Value(std::move(value)) {}
+    Expr* Value;
+    ReturnStmt(Expr* value) : Stmt(StmtKind::Return), Value(value) {}
 };
 
 // Statement for a print call
 struct PrintStmt : Stmt {
-    std::unique_ptr<Expr> Format;
-    std::vector<std::unique_ptr<Expr>> Args;
-    PrintStmt(std::unique_ptr<Expr> format, std::vector<std::unique_ptr<Expr>> args)
-        : Format(std::move(format)), Args(std::move(args)) {}
+    Expr* Format;
+    std::span<Expr*> Args;
+    PrintStmt(Expr* format, std::span<Expr*> args)
+        : Stmt(StmtKind::Print), Format(format), Args(args) {}
 };
 
 // Statement for a scan call
 struct ScanStmt : Stmt {
-    std::unique_ptr<VariableExpr> Var;
-    ScanStmt(std::unique_ptr<VariableExpr> var) : Var(std::move(var)) {}
+    VariableExpr* Var;
+    ScanStmt(VariableExpr* var) : Stmt(StmtKind::Scan), Var(var) {}
 };
 // Statement for an expression
 struct ExprStmt : Stmt {
-    std::unique_ptr<Expr> Expression;
-    ExprStmt(std::unique_ptr<Expr> expr) : Expression(std::move(expr)) {}
+    Expr* Expression;
+    ExprStmt(Expr* expr) : Stmt(StmtKind::Expr), Expression(expr) {}
 };
 
 
@@ -106,43 +155,69 @@ struct BlockStmt;
 
 // Statement for an if-else
 struct IfStmt : Stmt {
-    std::unique_ptr<Expr> Condition;
-    std::unique_ptr<BlockStmt> ThenBranch;
-    std::unique_ptr<BlockStmt> ElseBranch; // Can be nullptr
-    IfStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> thenBranch, std::unique_ptr<BlockStmt> elseBranch);
+    Expr* Condition;
+    BlockStmt* ThenBranch;
+    BlockStmt* ElseBranch; // Can be nullptr
+    IfStmt(Expr* condition, BlockStmt* thenBranch, BlockStmt* elseBranch);
 };
 
 // Statement for a while loop
 struct WhileStmt : Stmt {
-    std::unique_ptr<Expr> Condition;
-    std::unique_ptr<BlockStmt> Body;
-    WhileStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> body);
+    Expr* Condition;
+    BlockStmt* Body;
+    WhileStmt(Expr* condition, BlockStmt* body);
+};
+
+// Statement for a for loop. Init runs once before the first test of
+// Condition, Step after every iteration; all three can be left out.
+struct ForStmt : Stmt {
+    Stmt* Init; // VarDeclStmt or AssignStmt
+    Expr* Condition;
+    Stmt* Step; // AssignStmt
+    BlockStmt* Body;
+    ForStmt(Stmt* init, Expr* condition, Stmt* step, BlockStmt* body);
 };
 
 // Statement for a block of statements
 struct BlockStmt : Stmt {
-    std::vector<std::unique_ptr<Stmt>> Statements;
+    std::span<Stmt*> Statements;
+    BlockStmt(std::span<Stmt*> statements) : Stmt(StmtKind::Block), Statements(statements) {}
 };
 
 // Statement for a function prototype (declaration)
 struct PrototypeAST {
-    std::string Name;
-    std::vector<std::pair<std::string, std::string>> Args; // (type, name)
-    std::string ReturnType;
-    PrototypeAST(const std::string& name, std::vector<std::pair<std::string, std::string>> args, const std::string& returnType)
-        : Name(name), Args(std::move(args)), ReturnType(returnType) {}
+    Symbol Name;
+    std::span<std::pair<std::string_view, Symbol>> Args; // (type, name)
+    std::string_view ReturnType;
+    PrototypeAST(Symbol name, std::span<std::pair<std::string_view, Symbol>> args, std::string_view returnType)
+        : Name(name), Args(args), ReturnType(returnType) {}
 };
 
 // Statement for a function definition
 struct FunctionAST {
-    std::unique_ptr<PrototypeAST> Proto;
-    std::unique_ptr<BlockStmt> Body;
-    FunctionAST(std::unique_ptr<PrototypeAST> proto, std::unique_ptr<BlockStmt> body);
+    PrototypeAST* Proto;
+    BlockStmt* Body;
+    FunctionAST(PrototypeAST* proto, BlockStmt* body);
 };
 
+// Array parameters are spelled "<element>[]" and passed by reference.
+// arrayTypeName returns that spelling, or an empty view if the element type
+// can't be stored in arrays; arrayElementType undoes it, or returns an
+// empty view for other types.
+std::string_view arrayTypeName(std::string_view elementType);
+std::string_view arrayElementType(std::string_view type);
+
+// Vector types are spelled "<element><lanes>", e.g. "float4".
+// vectorTypeName maps source text to that spelling, or to an empty view if
+// it isn't a vector type; vectorElementType splits a spelling into element
+// type and lane count, or returns an empty view for other types.
+std::string_view vectorTypeName(std::string_view text);
+std::string_view vectorElementType(std::string_view type, unsigned& lanes);
+
 // Top-level module/translation unit
 struct ModuleAST {
-    std::vector<std::unique_ptr<FunctionAST>> Functions;
+    Arena Nodes; // Owns every node reachable from Functions
+    std::vector<FunctionAST*> Functions;
 };
 
-#endif
\ No newline at end of file
+#endif
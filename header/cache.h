@@ -0,0 +1,46 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "ast.h"
+#include "callgraph.h"
+#include "target.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+// On-disk cache of optimized per-function bitcode, keyed by a content hash
+// of the function. Entries are written to a temporary file and renamed into
+// place, so one directory can be shared by threads and compiler processes.
+class FunctionCache {
+public:
+    FunctionCache(std::string directory, uint64_t maxSizeBytes);
+    // Creates the cache directory if needed.
+    bool open();
+
+    // Hashes everything that decides the optimized IR of func: its
+    // prototype, its body, the prototypes of the functions it calls, the
+    // optimization level and the target CPU and features, plus the calling
+    // conventions whole-program mode assigns them. Formatting and comments
+    // don't take part.
+    std::string key(FunctionAST& func, const llvm::StringMap<const PrototypeAST*>& protos, unsigned optLevel,
+                    const TargetSpec& target, const ProgramLinkage* linkage = nullptr) const;
+    std::unique_ptr<llvm::MemoryBuffer> lookup(const std::string& key);
+    void store(const std::string& key, llvm::StringRef bitcode);
+    // Evicts the least recently used entries until the size limit holds.
+    void prune();
+
+    unsigned hits() const { return hitCount; }
+    unsigned misses() const { return missCount; }
+
+private:
+    std::string entryPath(const std::string& key) const;
+
+    std::string directory;
+    uint64_t maxSizeBytes;
+    std::atomic<unsigned> hitCount{0};
+    std::atomic<unsigned> missCount{0};
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "ast.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <string>
+#include <vector>
+
+// Which functions a whole program keeps, and how they are linked. Functions
+// defined by the inputs are live if main or an exported function can reach
+// them. Live functions that nothing outside their own input calls become
+// internal and use the fast calling convention.
+struct ProgramLinkage {
+    llvm::StringSet<> defined;
+    llvm::StringSet<> live;
+    llvm::StringSet<> external; // main, exports and callees of other inputs
+
+    // Functions the program doesn't define (imports, libc) are always kept.
+    bool emits(llvm::StringRef name) const { return !defined.count(name) || live.count(name); }
+    bool isInternal(llvm::StringRef name) const { return live.count(name) && !external.count(name); }
+};
+
+// Call graph over the functions of every input, built from the AST after
+// folding so calls in removed branches don't keep functions alive.
+class CallGraph {
+public:
+    // Records the functions defined by one input and the calls they make.
+    void addModule(ModuleAST& ast, unsigned unit);
+    // Walks the graph from main and the exported functions.
+    ProgramLinkage link(const std::vector<std::string>& exports) const;
+
+private:
+    struct Node {
+        unsigned unit;
+        std::vector<std::string_view> callees;
+    };
+    llvm::StringMap<Node> nodes;
+};
+
+#endif
@@ -2,26 +2,105 @@
 #define CODEGEN_H
 
 #include "ast.h"
+#include "cache.h"
+#include "callgraph.h"
+#include "target.h"
+#include "timereport.h"
+#include "visitor.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/Module.h"
-#include <map>
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Support/PGOOptions.h"
+#include "llvm/Target/TargetMachine.h"
 #include <memory>
+#include <string>
+#include <vector>
+
+class CodeGen : private ASTVisitor<CodeGen, llvm::Value*> {
+    friend class ASTVisitor<CodeGen, llvm::Value*>;
 
-class CodeGen {
 public:
-    CodeGen();
-    void generate(ModuleAST& ast);
+    // The module is set up for target right away, so the IR is generated
+    // against its data layout and every function carries its CPU and
+    // features.
+    explicit CodeGen(const TargetSpec& target = TargetSpec());
+    // With jobs > 1, function bodies are generated on a thread pool, each
+    // worker into its own context and module, and the results are linked
+    // back in source order.
+    void generate(ModuleAST& ast, unsigned jobs = 1);
+    // Generates and optimizes every function in a module of its own, taking
+    // the optimized bitcode from the cache when the function hashes the
+    // same. Calls between functions are left to optimize() with
+    // Pipeline::CachedLink once they are linked.
+    bool generateCached(ModuleAST& ast, FunctionCache& cache, unsigned optLevel, unsigned jobs = 1);
+    // Declares an externally defined function, e.g. one loaded from a
+    // module interface file.
+    void declare(PrototypeAST& proto);
+    // Moves the module of another CodeGen into this one, resolving calls
+    // between the two. The other CodeGen is left without a module.
+    bool link(CodeGen& other);
+    enum class Pipeline {
+        PerModule,
+        // For modules that go through a ThinLTO link afterwards.
+        ThinLTOPreLink,
+        // For the module generateCached() linked from functions that were
+        // optimized one at a time: inlines across them and reruns the late
+        // optimizations.
+        CachedLink,
+    };
+    bool optimize(unsigned optLevel, bool timePasses = false, Pipeline pipeline = Pipeline::PerModule);
+    // Verification, the pass pipeline and each pass in it are timed into
+    // report from now on.
+    void setTimeReport(TimeReport* report) { timeReport = report; }
+    // Whole-program mode: functions the plan doesn't keep are not emitted,
+    // and internal ones get internal linkage and the fast calling
+    // convention. The plan must outlive code generation.
+    void setLinkage(const ProgramLinkage* plan) { linkage = plan; }
+    // Profile-guided optimization for optimize(): IRInstr instruments the
+    // module to count branches and calls, IRUse attaches the branch weights
+    // and entry counts of an indexed profile before the pipeline runs.
+    void setProfile(const llvm::PGOOptions& options) { pgo = options; }
+    size_t instructionCount() const;
     void dump();
     bool writeToFile(const std::string& filename);
+    // Writes bitcode with a ThinLTO module summary. moduleName identifies
+    // the module in a link and has to be unique among its inputs.
+    void writeThinLTOBitcode(llvm::raw_ostream& os, llvm::StringRef moduleName);
+    bool writeBitcodeFile(const std::string& filename, llvm::StringRef moduleName);
+    // Emits a native object or assembly file for the target straight from
+    // the in-memory module.
+    bool emitNativeFile(const std::string& filename, bool assembly);
+    // Hands the module to an in-process LLJIT and calls main. The module is
+    // consumed, so no other output can be produced afterwards.
+    bool runJIT(const std::string& programName, const std::vector<std::string>& args, int& exitCode);
 
 private:
     llvm::Value* logErrorV(const char* str);
-    llvm::Function* getFunction(std::string name);
-    llvm::Type* getType(const std::string& typeName);
+    llvm::Function* getFunction(llvm::StringRef name);
+    llvm::Constant* stringConstant(llvm::StringRef text);
+    void mergeStringConstants();
+    void printValue(llvm::Value* value);
+    bool printSplit(std::string_view format, std::span<Expr*> args, const std::vector<llvm::Value*>& values);
+    llvm::Type* getType(llvm::StringRef typeName);
+    llvm::Value* elementPointer(IndexExpr& ast, llvm::Type*& elementType);
+    llvm::Value* laneIndex(Expr& index, llvm::FixedVectorType* vectorType);
+    llvm::Value* condition(Expr& expr, const char* name);
+    void declareArray(VarDeclStmt& ast, llvm::IRBuilder<>& entry);
+    void freeHeapArrays(llvm::Function* function);
+    llvm::TargetMachine* getTargetMachine();
+    void declarePrototypes(ModuleAST& ast);
+    bool linkBitcode(llvm::StringRef bitcode, llvm::StringRef name);
+    void dropUnusedDeclarations();
+    bool emits(const PrototypeAST& proto) const;
+    void internalize();
+    void registerPassTimers(llvm::PassInstrumentationCallbacks& PIC);
+
+    using ASTVisitor::visit;
 
     // Expression visitors
-    llvm::Value* visit(Expr& ast);
     llvm::Value* visit(NumberExpr& ast);
     llvm::Value* visit(StringExpr& ast);
     llvm::Value* visit(BoolExpr& ast);
@@ -29,9 +108,11 @@ private:
     llvm::Value* visit(BinaryExpr& ast);
     llvm::Value* visit(UnaryExpr& ast);
     llvm::Value* visit(CallExpr& ast);
+    llvm::Value* visit(IndexExpr& ast);
+    llvm::Value* visit(VectorExpr& ast);
+    llvm::Value* visitReduction(CallExpr& ast);
 
     // Statement visitors
-    void visit(Stmt& ast);
     void visit(BlockStmt& ast);
     void visit(ReturnStmt& ast);
     void visit(PrintStmt& ast);
@@ -40,6 +121,8 @@ private:
     void visit(VarDeclStmt& ast);
     void visit(IfStmt& ast);
     void visit(WhileStmt& ast);
+    void visit(AssignStmt& ast);
+    void visit(ForStmt& ast);
 
     // Top-level visitors
     llvm::Function* visit(PrototypeAST& ast);
@@ -49,7 +132,16 @@ private:
     std::unique_ptr<llvm::LLVMContext> context;
     std::unique_ptr<llvm::IRBuilder<>> builder;
     std::unique_ptr<llvm::Module> module;
-    std::map<std::string, llvm::AllocaInst*> namedValues;
+    std::unique_ptr<llvm::TargetMachine> targetMachine;
+    TargetSpec target;
+    llvm::DenseMap<uint32_t, llvm::AllocaInst*> namedValues; // keyed by Symbol::Id
+    llvm::DenseMap<uint32_t, std::string_view> namedTypes; // declared Cat types, keyed by Symbol::Id
+    std::vector<llvm::AllocaInst*> heapArrays; // pointer slots freed on return
+    std::vector<PrototypeAST*> externalProtos; // from declare(), replayed in workers
+    llvm::StringMap<llvm::Constant*> strings; // pooled string literals
+    TimeReport* timeReport = nullptr;
+    const ProgramLinkage* linkage = nullptr;
+    llvm::Optional<llvm::PGOOptions> pgo;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef CONSTFOLD_H
+#define CONSTFOLD_H
+
+#include "ast.h"
+#include "visitor.h"
+#include <vector>
+
+// Folds constant expressions and removes statements that can never run,
+// between parsing and code generation. Folding follows the IR CodeGen would
+// emit (i32 wrap-around, float arithmetic, unordered float compares and
+// && / || evaluating both sides), so the program behaves the same.
+class ConstantFolder : private ASTVisitor<ConstantFolder, Expr*> {
+    friend class ASTVisitor<ConstantFolder, Expr*>;
+
+public:
+    // Replacement nodes are allocated from the module's arena.
+    void run(ModuleAST& ast);
+
+    size_t foldedExpressions() const { return folded; }
+    size_t removedStatements() const { return removed; }
+
+private:
+    using ASTVisitor::visit;
+
+    // Expression visitors return the node that replaces the visited one
+    Expr* visit(NumberExpr& ast) { return &ast; }
+    Expr* visit(StringExpr& ast) { return &ast; }
+    Expr* visit(BoolExpr& ast) { return &ast; }
+    Expr* visit(VariableExpr& ast) { return &ast; }
+    Expr* visit(BinaryExpr& ast);
+    Expr* visit(UnaryExpr& ast);
+    Expr* visit(CallExpr& ast);
+    Expr* visit(IndexExpr& ast);
+    Expr* visit(VectorExpr& ast);
+
+    // Statement visitors fold in place; blocks drop dead statements
+    void visit(BlockStmt& ast);
+    void visit(ReturnStmt& ast);
+    void visit(PrintStmt& ast);
+    void visit(ExprStmt& ast);
+    void visit(ScanStmt&) {}
+    void visit(VarDeclStmt& ast);
+    void visit(IfStmt& ast);
+    void visit(WhileStmt& ast);
+    void visit(AssignStmt& ast);
+    void visit(ForStmt& ast);
+
+    Expr* fold(Expr*& expr);
+    bool appendLive(Stmt* stmt);
+    void appendDeclarations(Stmt* stmt);
+    Expr* makeBool(bool value);
+
+    Arena* arena = nullptr;
+    // Live statements of the blocks being rebuilt, innermost block last
+    std::vector<Stmt*> stmtScratch;
+    size_t folded = 0;
+    size_t removed = 0;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef INTERFACE_H
+#define INTERFACE_H
+
+#include "ast.h"
+#include <string>
+#include <vector>
+
+// Binary module interface (.cati) holding the function prototypes of a
+// module, so dependents can declare them without lexing or parsing.
+//
+// Layout (all integers little-endian):
+//   header   : "CATI", u32 version, u32 protoCount, u32 argCount
+//   protos   : protoCount x { u32 nameOff, u32 nameLen, u8 retType, u8 pad, u16 argCount, u32 firstArg }
+//   args     : argCount x { u8 type, u8 pad[3], u32 nameOff, u32 nameLen }
+//   strings  : name bytes referenced by the offsets above
+//
+// Records are fixed size, so the file can be used directly from an mmap.
+class ModuleInterface {
+public:
+    static bool write(const ModuleAST& ast, const std::string& filename);
+    // Prototypes are allocated from the given arena and their names are
+    // interned into symbols.
+    static bool read(const std::string& filename, Arena& arena, SymbolTable& symbols, std::vector<PrototypeAST*>& protos);
+};
+
+#endif
@@ -1,20 +1,36 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "symbol.h"
 #include "token.h"
-#include <string>
+#include <string_view>
 #include <vector>
 
 class Lexer {
 public:
-    Lexer(const std::string& source);
+    // The source buffer is not copied and must outlive the tokens.
+    Lexer(std::string_view source, SymbolTable& symbols);
+    // Lexes the next token on demand. Returns END_OF_FILE once the source is
+    // exhausted, and keeps returning it.
+    Token next();
     std::vector<Token> tokenize();
 
+    std::string_view text(const Token& token) const { return source.substr(token.offset, token.length); }
+    SymbolTable& symbolTable() { return symbols; }
+    // Tokens handed out by next() so far.
+    size_t tokenCount() const { return tokensLexed; }
+
+    // Decodes the escapes of a string literal body into out, which must hold
+    // at least raw.size() bytes. Returns the decoded length.
+    static size_t unescape(std::string_view raw, char* out);
+
 private:
     void skipWhitespace();
     Token nextToken();
+    Token makeToken(TokenType type);
     Token identifier();
     Token number();
+    void skipDigits();
     Token stringLiteral();
     char advance();
     bool isAtEnd();
@@ -25,11 +41,14 @@ private:
     bool isAlpha(char c);
     bool isAlphaNumeric(char c);
 
-    std::string source;
-    int start = 0;
-    int current = 0;
-    int line = 1;
-    int column = 1;
+    std::string_view source;
+    SymbolTable& symbols;
+    uint32_t start = 0;
+    uint32_t current = 0;
+    uint32_t line = 1;
+    uint32_t column = 1;
+    uint32_t startColumn = 1;
+    size_t tokensLexed = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -8,39 +8,63 @@
 
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens);
+    // Tokens are pulled from the lexer as parsing proceeds, so lexing and
+    // parsing interleave and only a few tokens are held at a time.
+    Parser(Lexer& lexer);
     std::unique_ptr<ModuleAST> parse();
 
 private:
-    std::unique_ptr<Stmt> parseStatement();
-    std::unique_ptr<Expr> parseExpression();
-    std::unique_ptr<Expr> parsePrimary();
-    std::unique_ptr<Expr> parseUnary();
-    std::unique_ptr<Expr> parseBinOpRHS(int exprPrec, std::unique_ptr<Expr> LHS);
-    std::unique_ptr<PrototypeAST> parsePrototype();
-    std::unique_ptr<FunctionAST> parseDefinition();
-    std::unique_ptr<Expr> parseIdentifierExpr();
-    std::unique_ptr<Expr> parseNumberExpr();
-    std::unique_ptr<Expr> parseStringExpr();
-    std::unique_ptr<Expr> parseBoolExpr();
-    std::unique_ptr<Expr> parseParenExpr();
-    std::unique_ptr<Stmt> parseReturnStmt();
-    std::unique_ptr<Stmt> parsePrintStmt();
-    std::unique_ptr<Stmt> parseScanStmt();
-    std::unique_ptr<Stmt> parseVarDeclStmt();
-    std::unique_ptr<Stmt> parseIfStmt();
-    std::unique_ptr<Stmt> parseWhileStmt();
-    std::unique_ptr<BlockStmt> parseBlock();
-
-    Token& currentToken();
+    Stmt* parseStatement();
+    Expr* parseExpression();
+    Expr* parsePrimary();
+    Expr* parseUnary();
+    Expr* parseBinOpRHS(int exprPrec, Expr* LHS);
+    PrototypeAST* parsePrototype();
+    FunctionAST* parseDefinition();
+    Expr* parseIdentifierExpr();
+    Expr* parseNumberExpr();
+    Expr* parseStringExpr();
+    Expr* parseBoolExpr();
+    Expr* parseParenExpr();
+    Expr* parseVectorExpr();
+    Stmt* parseReturnStmt();
+    Stmt* parsePrintStmt();
+    Stmt* parseScanStmt();
+    Stmt* parseVarDeclStmt();
+    Stmt* parseIfStmt();
+    Stmt* parseWhileStmt();
+    Stmt* parseForStmt();
+    Stmt* parseAssignment();
+    BlockStmt* parseBlock();
+
+    const Token& currentToken();
+    const Token& peekToken(size_t n);
+    std::string_view tokenText(const Token& token);
+    Symbol tokenSymbol(const Token& token);
     void advance();
     bool check(TokenType type);
     bool match(TokenType type);
     bool isType();
+    std::string_view typeName(const Token& token);
     int getTokPrecedence();
 
-    std::vector<Token> tokens;
-    size_t current = 0;
+    template <typename T>
+    std::span<T> takeScratch(std::vector<T>& scratch, size_t start);
+
+    // Ring buffer of lexed but not yet consumed tokens
+    static constexpr size_t MaxLookahead = 4;
+
+    Lexer& lexer;
+    Token lookahead[MaxLookahead];
+    size_t head = 0;
+    size_t buffered = 0;
+    Arena* arena = nullptr;
+
+    // Child lists are collected on these stacks and copied into the arena
+    // once complete, so nested lists share one growing buffer.
+    std::vector<Expr*> exprScratch;
+    std::vector<Stmt*> stmtScratch;
+    std::vector<std::pair<std::string_view, Symbol>> argScratch;
 };
 
 #endif
\ No newline at end of file
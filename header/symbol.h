@@ -0,0 +1,46 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include "arena.h"
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Interned identifier. Equal names share one id, so comparisons are a
+// single integer compare; Text views memory owned by the SymbolTable.
+struct Symbol {
+    uint32_t Id = 0;
+    std::string_view Text;
+
+    bool operator==(const Symbol& other) const { return Id == other.Id; }
+};
+
+// Interns identifier spellings. Id 0 is reserved for "no symbol".
+class SymbolTable {
+public:
+    SymbolTable() { names.push_back({}); }
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    uint32_t intern(std::string_view name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        std::string_view stored = storage.copyString(name);
+        uint32_t id = names.size();
+        names.push_back(stored);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    Symbol get(uint32_t id) const { return {id, names[id]}; }
+    Symbol get(std::string_view name) { return get(intern(name)); }
+    size_t size() const { return names.size(); }
+
+private:
+    Arena storage;
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+#endif
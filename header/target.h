@@ -0,0 +1,25 @@
+#ifndef TARGET_H
+#define TARGET_H
+
+#include <string>
+
+// The machine code is generated for: the host triple, a CPU and a list of
+// subtarget features. The default is a generic CPU of the host
+// architecture, which runs on any machine of that kind.
+struct TargetSpec {
+    std::string triple;
+    std::string cpu = "generic";
+    std::string features; // comma-separated, e.g. "+avx2,-avx512f"
+
+    TargetSpec();
+    // Sets the CPU from -march or -mcpu. "native" selects the host CPU with
+    // every feature the host reports.
+    void setCPU(const std::string& name);
+    // Appends -mattr features; later ones override earlier ones.
+    void addFeatures(const std::string& list);
+    // Checks the CPU against the target's list of known CPUs. Unknown
+    // features are reported by LLVM when code is generated.
+    bool validate() const;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef THINLTO_H
+#define THINLTO_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "target.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm::lto {
+class LTO;
+}
+
+// In-process ThinLTO link over the summary-carrying bitcode of every input
+// (see CodeGen::writeThinLTOBitcode). The combined summary lets each backend
+// import the functions it calls from other inputs, so small helpers are
+// inlined across files, and the backends optimize and generate code for
+// their module in parallel. Only the preserved symbols (main and exports)
+// stay visible to the native link; everything else can be internalized and
+// dropped once it is no longer called.
+class ThinLTOLink {
+public:
+    ThinLTOLink(unsigned optLevel, unsigned jobs, llvm::StringSet<> preserved, const TargetSpec& target);
+    ~ThinLTOLink();
+
+    // name identifies the module in the combined index and in diagnostics,
+    // so it must be unique across the link.
+    bool add(const std::string& name, llvm::SmallVector<char, 0> bitcode);
+    // Writes one native object per backend task to a temporary file and
+    // appends its path to objectFiles.
+    bool run(std::vector<std::string>& objectFiles);
+
+private:
+    std::unique_ptr<llvm::lto::LTO> lto;
+    llvm::StringSet<> preserved;
+    llvm::StringSet<> defined;
+    // Input files refer into the bitcode, which has to outlive the link.
+    std::vector<std::unique_ptr<llvm::SmallVector<char, 0>>> buffers;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TIMEREPORT_H
+#define TIMEREPORT_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Wall-clock time per compiler phase and per LLVM pass, plus size counters,
+// printed as a table or as JSON for --time-report. Units compiled in
+// parallel add into the same report, so phases and counters are summed over
+// inputs while the total is the wall time of the whole run.
+class TimeReport {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Adds the time from construction to destruction to a phase.
+    class Scope {
+    public:
+        Scope(TimeReport* report, llvm::StringRef phase)
+            : report(report), phase(phase), start(report ? Clock::now() : Clock::time_point()) {}
+        ~Scope() {
+            if (report) report->addPhase(phase, Clock::now() - start);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TimeReport* report;
+        llvm::StringRef phase;
+        Clock::time_point start;
+    };
+
+    TimeReport() : start(Clock::now()) {}
+
+    void addPhase(llvm::StringRef phase, Clock::duration time);
+    void addPass(llvm::StringRef pass, Clock::duration time);
+    void addCount(llvm::StringRef counter, uint64_t value);
+
+    void printTable(llvm::raw_ostream& os) const;
+    void printJSON(llvm::raw_ostream& os) const;
+
+private:
+    struct PassTime {
+        Clock::duration time{};
+        unsigned runs = 0;
+    };
+
+    mutable std::mutex lock;
+    Clock::time_point start;
+    // Phases and counters keep the order they were first reported in.
+    std::vector<std::pair<std::string, Clock::duration>> phases;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    llvm::StringMap<PassTime> passes;
+};
+
+#endif
@@ -1,24 +1,25 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Keywords
-    FN, RETURN, IF, ELSE, WHILE,
-    INT_TYPE, FLOAT_TYPE, STRING_TYPE, BOOL_TYPE,
+    FN, RETURN, IF, ELSE, WHILE, FOR,
+    INT_TYPE, FLOAT_TYPE, STRING_TYPE, BOOL_TYPE, VECTOR_TYPE,
     PRINT, SCAN, MEOW, MAIN,
 
     // Literals
     IDENTIFIER, INT_LITERAL, FLOAT_LITERAL, STRING_LITERAL, BOOL_LITERAL,
 
     // Operators
-    ASSIGN, PLUS, GT, LESS, ARROW, COLON,
+    ASSIGN, PLUS, MINUS, STAR, SLASH, GT, LESS, ARROW, COLON,
     EQUAL_EQUAL, BANG_EQUAL, LESS_EQUAL, GREATER_EQUAL,
     AMPERSAND_AMPERSAND, PIPE_PIPE, BANG,
 
     // Punctuation
-    LPAREN, RPAREN, LBRACE, RBRACE, SEMICOLON, COMMA,
+    LPAREN, RPAREN, LBRACE, RBRACE, LBRACKET, RBRACKET, SEMICOLON, COMMA,
 
     // Other
     COMMENT,
@@ -26,11 +27,62 @@ enum class TokenType {
     UNKNOWN
 };
 
+// A token is a view into the source buffer it was lexed from: the text is
+// source.substr(offset, length). Identifiers also carry their interned
+// symbol id.
 struct Token {
     TokenType type;
-    std::string value;
-    int line;
-    int column;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t symbol;
+    uint32_t line;
+    uint32_t column;
 };
 
-#endif
\ No newline at end of file
+// Fixed spelling of keyword, operator and punctuation tokens; empty for
+// tokens whose text depends on the source.
+constexpr std::string_view tokenSpelling(TokenType type) {
+    switch (type) {
+        case TokenType::FN: return "fn";
+        case TokenType::RETURN: return "return";
+        case TokenType::IF: return "if";
+        case TokenType::ELSE: return "else";
+        case TokenType::WHILE: return "while";
+        case TokenType::FOR: return "for";
+        case TokenType::INT_TYPE: return "int";
+        case TokenType::FLOAT_TYPE: return "float";
+        case TokenType::STRING_TYPE: return "string";
+        case TokenType::BOOL_TYPE: return "bool";
+        case TokenType::PRINT: return "print";
+        case TokenType::SCAN: return "scan";
+        case TokenType::MEOW: return "meow";
+        case TokenType::MAIN: return "main";
+        case TokenType::ASSIGN: return "=";
+        case TokenType::PLUS: return "+";
+        case TokenType::MINUS: return "-";
+        case TokenType::STAR: return "*";
+        case TokenType::SLASH: return "/";
+        case TokenType::GT: return ">";
+        case TokenType::LESS: return "<";
+        case TokenType::ARROW: return "->";
+        case TokenType::COLON: return ":";
+        case TokenType::EQUAL_EQUAL: return "==";
+        case TokenType::BANG_EQUAL: return "!=";
+        case TokenType::LESS_EQUAL: return "<=";
+        case TokenType::GREATER_EQUAL: return ">=";
+        case TokenType::AMPERSAND_AMPERSAND: return "&&";
+        case TokenType::PIPE_PIPE: return "||";
+        case TokenType::BANG: return "!";
+        case TokenType::LPAREN: return "(";
+        case TokenType::RPAREN: return ")";
+        case TokenType::LBRACE: return "{";
+        case TokenType::RBRACE: return "}";
+        case TokenType::LBRACKET: return "[";
+        case TokenType::RBRACKET: return "]";
+        case TokenType::SEMICOLON: return ";";
+        case TokenType::COMMA: return ",";
+        default: return "";
+    }
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef VISITOR_H
+#define VISITOR_H
+
+#include "ast.h"
+
+// Dispatches on the node kind tag instead of dynamic_cast. Passes derive
+// from this (CRTP), pull the dispatchers in with `using ASTVisitor::visit;`
+// and provide a visit overload for every concrete node type.
+template <typename Derived, typename ExprRet = void, typename StmtRet = void>
+class ASTVisitor {
+public:
+    ExprRet visit(Expr& ast) {
+        switch (ast.Kind) {
+            case ExprKind::Number: return derived().visit(static_cast<NumberExpr&>(ast));
+            case ExprKind::String: return derived().visit(static_cast<StringExpr&>(ast));
+            case ExprKind::Bool: return derived().visit(static_cast<BoolExpr&>(ast));
+            case ExprKind::Variable: return derived().visit(static_cast<VariableExpr&>(ast));
+            case ExprKind::Binary: return derived().visit(static_cast<BinaryExpr&>(ast));
+            case ExprKind::Unary: return derived().visit(static_cast<UnaryExpr&>(ast));
+            case ExprKind::Call: return derived().visit(static_cast<CallExpr&>(ast));
+            case ExprKind::Index: return derived().visit(static_cast<IndexExpr&>(ast));
+            case ExprKind::Vector: return derived().visit(static_cast<VectorExpr&>(ast));
+        }
+        return ExprRet();
+    }
+
+    StmtRet visit(Stmt& ast) {
+        switch (ast.Kind) {
+            case StmtKind::Block: return derived().visit(static_cast<BlockStmt&>(ast));
+            case StmtKind::Return: return derived().visit(static_cast<ReturnStmt&>(ast));
+            case StmtKind::Print: return derived().visit(static_cast<PrintStmt&>(ast));
+            case StmtKind::Expr: return derived().visit(static_cast<ExprStmt&>(ast));
+            case StmtKind::Scan: return derived().visit(static_cast<ScanStmt&>(ast));
+            case StmtKind::VarDecl: return derived().visit(static_cast<VarDeclStmt&>(ast));
+            case StmtKind::If: return derived().visit(static_cast<IfStmt&>(ast));
+            case StmtKind::While: return derived().visit(static_cast<WhileStmt&>(ast));
+            case StmtKind::Assign: return derived().visit(static_cast<AssignStmt&>(ast));
+            case StmtKind::For: return derived().visit(static_cast<ForStmt&>(ast));
+        }
+        return StmtRet();
+    }
+
+private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
+
+#endif
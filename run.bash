@@ -15,14 +15,10 @@ cmake ..
 echo "Building with make..."
 make
 
-# Run the compiler to generate LLVM IR
-echo "Generating LLVM IR..."
-./cat ../test/main.cat
-
-# Compile the LLVM IR with clang
-echo "Compiling LLVM IR with clang..."
-clang output.ll -o my_program
+# Compile straight to a native executable
+echo "Compiling to a native executable..."
+./cat --emit=exe ../test/main.cat
 
 # Run the compiled program
 echo "Running the compiled program..."
-./my_program
\ No newline at end of file
+./output
\ No newline at end of file
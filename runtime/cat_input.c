@@ -0,0 +1,215 @@
+#include "cat_runtime.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE (64 * 1024)
+
+// Longest float or bool spelling handed to the slow paths; longer tokens
+// are truncated there, which only affects digits that can't change a float.
+#define TOKEN_SIZE 128
+
+static char buffer[BUFFER_SIZE];
+static size_t pos, end;
+static bool atEnd;
+
+static bool refill(void) {
+    if (atEnd) {
+        return false;
+    }
+    // Whatever was printed so far may be the prompt for this input.
+    cat_flush();
+    ssize_t n;
+    do {
+        n = read(0, buffer, BUFFER_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        atEnd = true;
+        return false;
+    }
+    pos = 0;
+    end = (size_t)n;
+    return true;
+}
+
+// The next input character, or -1 at the end of input.
+static inline int peek(void) {
+    if (pos == end && !refill()) {
+        return -1;
+    }
+    return (unsigned char)buffer[pos];
+}
+
+static inline bool isSpace(int c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(int c) {
+    return (unsigned)(c - '0') < 10;
+}
+
+static int skipSpace(void) {
+    int c;
+    while (isSpace(c = peek())) {
+        ++pos;
+    }
+    return c;
+}
+
+// Copies characters accepted by keep into token, consuming them. Returns
+// the length, which may exceed what fit.
+static size_t readToken(char* token, bool (*keep)(int)) {
+    size_t length = 0;
+    int c;
+    while ((c = peek()) >= 0 && keep(c)) {
+        if (length + 1 < TOKEN_SIZE) {
+            token[length] = (char)c;
+        }
+        ++length;
+        ++pos;
+    }
+    token[length + 1 < TOKEN_SIZE ? length : TOKEN_SIZE - 1] = '\0';
+    return length;
+}
+
+void cat_scan_i32(int32_t* value) {
+    int c = skipSpace();
+    bool negative = c == '-';
+    if (c == '-' || c == '+') {
+        ++pos;
+        c = peek();
+    }
+    if (!isDigit(c)) {
+        return;
+    }
+    uint32_t result = 0;
+    do {
+        result = result * 10 + (uint32_t)(c - '0');
+        ++pos;
+        // Digits are taken straight from the buffer until it runs out
+        if (pos == end) {
+            c = peek();
+        } else {
+            c = (unsigned char)buffer[pos];
+        }
+    } while (isDigit(c));
+    *value = (int32_t)(negative ? 0u - result : result);
+}
+
+static bool isFloatChar(int c) {
+    return isDigit(c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-' ||
+           c == 'i' || c == 'n' || c == 'f' || c == 'a' || c == 't' || c == 'y' ||
+           c == 'I' || c == 'N' || c == 'F' || c == 'A' || c == 'T' || c == 'Y';
+}
+
+// Exactly representable powers of ten for the fast path.
+static const float PowersOfTen[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+void cat_scan_f32(float* value) {
+    skipSpace();
+    char token[TOKEN_SIZE];
+    size_t length = readToken(token, isFloatChar);
+    if (length == 0) {
+        return;
+    }
+
+    // Plain decimals with at most 7 significant digits and a small exponent
+    // are one correctly rounded float operation on exact operands.
+    const char* p = token;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') {
+        ++p;
+    }
+    uint32_t mantissa = 0;
+    int digits = 0, scale = 0;
+    bool seenDigit = false, seenPoint = false;
+    for (; *p; ++p) {
+        if (isDigit(*p)) {
+            seenDigit = true;
+            if (mantissa == 0 && *p == '0') {
+                scale -= seenPoint;
+                continue;
+            }
+            if (++digits > 7) {
+                break;
+            }
+            mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+            scale -= seenPoint;
+        } else if (*p == '.' && !seenPoint) {
+            seenPoint = true;
+        } else {
+            break;
+        }
+    }
+    if (*p == '\0' && seenDigit && length < TOKEN_SIZE && scale >= -10) {
+        float result = scale == 0 ? (float)mantissa : (float)mantissa / PowersOfTen[-scale];
+        *value = negative ? -result : result;
+        return;
+    }
+
+    // Exponents, long mantissas, inf and nan
+    char* parsed;
+    float result = strtof(token, &parsed);
+    if (parsed != token) {
+        *value = result;
+    }
+}
+
+static bool isWordChar(int c) {
+    return !isSpace(c);
+}
+
+void cat_scan_bool(bool* value) {
+    skipSpace();
+    char token[TOKEN_SIZE];
+    if (readToken(token, isWordChar) == 0) {
+        return;
+    }
+    if (strcmp(token, "true") == 0) {
+        *value = true;
+    } else if (strcmp(token, "false") == 0) {
+        *value = false;
+    } else {
+        char* parsed;
+        long number = strtol(token, &parsed, 10);
+        if (parsed != token && *parsed == '\0') {
+            *value = number != 0;
+        }
+    }
+}
+
+void cat_scan_str(char** value) {
+    if (skipSpace() < 0) {
+        return;
+    }
+    size_t capacity = 16, length = 0;
+    char* word = malloc(capacity);
+    if (!word) {
+        return;
+    }
+    int c;
+    while ((c = peek()) >= 0 && !isSpace(c)) {
+        // Copy the run of the word that is already buffered in one go
+        size_t run = 1;
+        while (pos + run < end && !isSpace((unsigned char)buffer[pos + run])) {
+            ++run;
+        }
+        if (length + run + 1 > capacity) {
+            while (length + run + 1 > capacity) {
+                capacity *= 2;
+            }
+            char* grown = realloc(word, capacity);
+            if (!grown) {
+                free(word);
+                return;
+            }
+            word = grown;
+        }
+        memcpy(word + length, buffer + pos, run);
+        length += run;
+        pos += run;
+    }
+    word[length] = '\0';
+    *value = word;
+}
@@ -0,0 +1,104 @@
+// Writes the raw profile of a program built with --profile-generate, in
+// place of compiler-rt's profile runtime. LLVM's instrumentation puts the
+// per-function records, counters and names in their own sections; this
+// copies them into a .profraw file at exit, which llvm-profdata merges into
+// the .profdata that --profile-use reads. Linked in only for instrumented
+// programs (through -u __llvm_profile_runtime). Value profiling isn't
+// supported: Cat emits no indirect calls or variable-length memory
+// intrinsics, so programs have no value sites.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The record layouts come from the LLVM the compiler is built against, so
+// they always match what its instrumentation emits. Included on its own
+// it defines the format constants; with a field macro, that list.
+#include "llvm/ProfileData/InstrProfData.inc"
+
+typedef void* IntPtrT;
+
+typedef enum ValueKind {
+#define VALUE_PROF_KIND(Enumerator, Value, Descr) Enumerator = Value,
+#include "llvm/ProfileData/InstrProfData.inc"
+} ValueKind;
+
+typedef struct __attribute__((aligned(INSTR_PROF_DATA_ALIGNMENT))) ProfileData {
+#define INSTR_PROF_DATA(Type, LLVMType, Name, Initializer) Type Name;
+#include "llvm/ProfileData/InstrProfData.inc"
+} ProfileData;
+
+typedef struct ProfileHeader {
+#define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Type Name;
+#include "llvm/ProfileData/InstrProfData.inc"
+} ProfileHeader;
+
+#define HIDDEN __attribute__((weak, visibility("hidden")))
+
+// The linker defines these for sections whose names are C identifiers.
+extern ProfileData __start___llvm_prf_data[] HIDDEN;
+extern ProfileData __stop___llvm_prf_data[] HIDDEN;
+extern char __start___llvm_prf_cnts[] HIDDEN;
+extern char __stop___llvm_prf_cnts[] HIDDEN;
+extern char __start___llvm_prf_names[] HIDDEN;
+extern char __stop___llvm_prf_names[] HIDDEN;
+
+// Emitted by the instrumentation: the format version with the IR-level
+// variant flags, and the --profile-generate=file name if one was given.
+extern uint64_t __llvm_profile_raw_version HIDDEN;
+extern const char __llvm_profile_filename[] HIDDEN;
+
+int __llvm_profile_runtime;
+
+static uint64_t padding(uint64_t size) {
+    return (8 - size % 8) % 8;
+}
+
+static void writeProfile(void) {
+    if (!&__llvm_profile_raw_version || !__start___llvm_prf_data) {
+        return;
+    }
+
+    const char* path = getenv("LLVM_PROFILE_FILE");
+    if (!path || !*path) {
+        path = &__llvm_profile_filename && *__llvm_profile_filename ? __llvm_profile_filename : "default.profraw";
+    }
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Could not write profile %s\n", path);
+        return;
+    }
+
+    uint64_t version = __llvm_profile_raw_version;
+    uint64_t counterSize = (version & VARIANT_MASK_BYTE_COVERAGE) ? 1 : 8;
+    uint64_t dataBytes = (uint64_t)((char*)__stop___llvm_prf_data - (char*)__start___llvm_prf_data);
+    uint64_t counterBytes = (uint64_t)(__stop___llvm_prf_cnts - __start___llvm_prf_cnts);
+    uint64_t nameBytes = (uint64_t)(__stop___llvm_prf_names - __start___llvm_prf_names);
+
+    ProfileHeader header = {0};
+    header.Magic = INSTR_PROF_RAW_MAGIC_64;
+    header.Version = version;
+    header.BinaryIdsSize = 0;
+    header.DataSize = dataBytes / sizeof(ProfileData);
+    header.PaddingBytesBeforeCounters = 0;
+    header.CountersSize = counterBytes / counterSize;
+    header.PaddingBytesAfterCounters = padding(counterBytes);
+    header.NamesSize = nameBytes;
+    header.CountersDelta = (uintptr_t)__start___llvm_prf_cnts - (uintptr_t)__start___llvm_prf_data;
+    header.NamesDelta = (uintptr_t)__start___llvm_prf_names;
+    header.ValueKindLast = IPVK_Last;
+
+    static const char zeros[8];
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(__start___llvm_prf_data, 1, dataBytes, out);
+    fwrite(__start___llvm_prf_cnts, 1, counterBytes, out);
+    fwrite(zeros, 1, padding(counterBytes), out);
+    fwrite(__start___llvm_prf_names, 1, nameBytes, out);
+    fwrite(zeros, 1, padding(nameBytes), out);
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Could not write profile %s\n", path);
+    }
+}
+
+__attribute__((constructor)) static void registerProfileWriter(void) {
+    atexit(writeProfile);
+}
@@ -0,0 +1,130 @@
+#include "cat_runtime.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_SIZE (64 * 1024)
+
+static char buffer[BUFFER_SIZE];
+static size_t used;
+
+__attribute__((constructor)) static void registerFlush(void) {
+    atexit(cat_flush);
+}
+
+void cat_flush(void) {
+    if (used) {
+        fwrite(buffer, 1, used, stdout);
+        used = 0;
+    }
+    fflush(stdout);
+}
+
+// Makes room for n more bytes; anything larger than the buffer is written
+// straight through by the caller.
+static inline char* reserve(size_t n) {
+    if (BUFFER_SIZE - used < n) {
+        cat_flush();
+    }
+    return buffer + used;
+}
+
+void cat_print_str(const char* text, int64_t length) {
+    size_t n = (size_t)length;
+    if (n > BUFFER_SIZE) {
+        cat_flush();
+        fwrite(text, 1, n, stdout);
+        return;
+    }
+    memcpy(reserve(n), text, n);
+    used += n;
+}
+
+static const char DigitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes the decimal digits of value ending at end, two at a time, and
+// returns where they start.
+static char* formatDigits(uint64_t value, char* end) {
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--end = DigitPairs[pair + 1];
+        *--end = DigitPairs[pair];
+    }
+    if (value >= 10) {
+        unsigned pair = (unsigned)value * 2;
+        *--end = DigitPairs[pair + 1];
+        *--end = DigitPairs[pair];
+    } else {
+        *--end = (char)('0' + value);
+    }
+    return end;
+}
+
+void cat_print_i32(int32_t value) {
+    char digits[16];
+    char* end = digits + sizeof(digits);
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    char* start = formatDigits(magnitude, end);
+    if (value < 0) {
+        *--start = '-';
+    }
+    size_t n = end - start;
+    memcpy(reserve(n), start, n);
+    used += n;
+}
+
+void cat_print_f32(float value) {
+    // A float times 10^6 needs at most 24 + 14 significant bits, so the
+    // product is exact in a double and rounding it to an integer gives the
+    // same digits as printf's "%f".
+    double scaled = (double)value * 1e6;
+    double magnitude = scaled < 0 ? -scaled : scaled;
+    if (!(magnitude < 9e18)) {
+        cat_printf("%f", (double)value); // inf, nan and huge values
+        return;
+    }
+    uint64_t units = (uint64_t)magnitude;
+    double fraction = magnitude - (double)units;
+    if (fraction > 0.5 || (fraction == 0.5 && (units & 1))) {
+        ++units; // round half to even, like printf
+    }
+
+    char digits[32];
+    char* end = digits + sizeof(digits);
+    char* start = formatDigits(units % 1000000 + 1000000, end);
+    *start = '.'; // replaces the leading 1 that kept the zeros
+    start = formatDigits(units / 1000000, start);
+    if (__builtin_signbit(value)) {
+        *--start = '-';
+    }
+    size_t n = end - start;
+    memcpy(reserve(n), start, n);
+    used += n;
+}
+
+void cat_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+    int n = vsnprintf(buffer + used, BUFFER_SIZE - used, format, args);
+    if (n >= 0 && (size_t)n >= BUFFER_SIZE - used) {
+        cat_flush();
+        if ((size_t)n < BUFFER_SIZE) {
+            n = vsnprintf(buffer, BUFFER_SIZE, format, retry);
+        } else {
+            vfprintf(stdout, format, retry);
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        used += n;
+    }
+    va_end(retry);
+    va_end(args);
+}
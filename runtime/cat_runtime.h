@@ -0,0 +1,41 @@
+#ifndef CAT_RUNTIME_H
+#define CAT_RUNTIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runtime library linked into every Cat executable, and into the compiler
+// for --run. print statements are lowered to these calls: the compiler
+// splits format strings at compile time, so most prints append digits or
+// literal text to one large stdout buffer without parsing a format. The
+// buffer is flushed when full, before scan has to wait for input, and at
+// exit. scan reads stdin in large chunks and parses values from memory.
+// Not thread-safe.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void cat_print_i32(int32_t value);
+// Formats like printf("%f"): six decimals, correctly rounded.
+void cat_print_f32(float value);
+void cat_print_str(const char* text, int64_t length);
+// Fallback for format strings the compiler doesn't split.
+void cat_printf(const char* format, ...);
+void cat_flush(void);
+
+// Each reader skips leading whitespace and parses one value. On a malformed
+// value or the end of input the variable keeps its old value, like scanf.
+void cat_scan_i32(int32_t* value);
+void cat_scan_f32(float* value);
+// Accepts true, false or an integer, which is true unless zero.
+void cat_scan_bool(bool* value);
+// Reads one whitespace-delimited word into a new allocation that lives
+// until the program exits.
+void cat_scan_str(char** value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#include "arena.h"
+
+void* Arena::allocateSlow(size_t size, size_t align) {
+    size_t needed = size + align - 1;
+    if (needed > SlabSize / 4) {
+        // Oversized requests get a slab of their own so the current one
+        // keeps serving small nodes.
+        slabs.push_back(std::unique_ptr<char[]>(new char[needed]));
+        reserved += needed;
+        char* base = slabs.back().get();
+        return base + (align - reinterpret_cast<uintptr_t>(base) % align) % align;
+    }
+
+    slabs.push_back(std::unique_ptr<char[]>(new char[SlabSize]));
+    reserved += SlabSize;
+    cur = slabs.back().get();
+    end = cur + SlabSize;
+    return allocate(size, align);
+}
@@ -1,10 +1,45 @@
 #include "ast.h"
+#include <iterator>
 
-IfStmt::IfStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> thenBranch, std::unique_ptr<BlockStmt> elseBranch)
-    : Condition(std::move(condition)), ThenBranch(std::move(thenBranch)), ElseBranch(std::move(elseBranch)) {}
+IfStmt::IfStmt(Expr* condition, BlockStmt* thenBranch, BlockStmt* elseBranch)
+    : Stmt(StmtKind::If), Condition(condition), ThenBranch(thenBranch), ElseBranch(elseBranch) {}
 
-WhileStmt::WhileStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> body)
-    : Condition(std::move(condition)), Body(std::move(body)) {}
+WhileStmt::WhileStmt(Expr* condition, BlockStmt* body)
+    : Stmt(StmtKind::While), Condition(condition), Body(body) {}
 
-FunctionAST::FunctionAST(std::unique_ptr<PrototypeAST> proto, std::unique_ptr<BlockStmt> body)
-    : Proto(std::move(proto)), Body(std::move(body)) {}
\ No newline at end of file
+FunctionAST::FunctionAST(PrototypeAST* proto, BlockStmt* body)
+    : Proto(proto), Body(body) {}
+
+ForStmt::ForStmt(Stmt* init, Expr* condition, Stmt* step, BlockStmt* body)
+    : Stmt(StmtKind::For), Init(init), Condition(condition), Step(step), Body(body) {}
+
+std::string_view arrayTypeName(std::string_view elementType) {
+    if (elementType == "int") return "int[]";
+    if (elementType == "float") return "float[]";
+    if (elementType == "bool") return "bool[]";
+    return {};
+}
+
+std::string_view arrayElementType(std::string_view type) {
+    if (type.size() > 2 && type.substr(type.size() - 2) == "[]") {
+        return type.substr(0, type.size() - 2);
+    }
+    return {};
+}
+
+static const std::string_view VectorTypes[] = {"int4", "int8", "float4", "float8", "bool4", "bool8"};
+
+std::string_view vectorTypeName(std::string_view text) {
+    for (std::string_view type : VectorTypes) {
+        if (type == text) return type;
+    }
+    return {};
+}
+
+std::string_view vectorElementType(std::string_view type, unsigned& lanes) {
+    if (vectorTypeName(type).empty()) {
+        return {};
+    }
+    lanes = type.back() - '0';
+    return type.substr(0, type.size() - 1);
+}
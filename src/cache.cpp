@@ -0,0 +1,224 @@
+#include "cache.h"
+#include "visitor.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+
+// Bump when the generated IR changes for the same source.
+static const char CacheVersion[] = "cat-cache-5";
+
+// pruneCache only touches files with this prefix.
+static const char EntryPrefix[] = "llvmcache-";
+
+namespace {
+
+// Feeds a canonical encoding of a function into SHA-1: node kinds, operators
+// and length-prefixed names and literals, so the hash only changes when the
+// tree does. Callees are collected so their prototypes can be hashed too.
+class FunctionHasher : public ASTVisitor<FunctionHasher> {
+public:
+    llvm::SHA1 sha;
+    std::vector<std::string_view> callees;
+
+    using ASTVisitor::visit;
+
+    void add(uint8_t tag) { sha.update(llvm::ArrayRef<uint8_t>(tag)); }
+    void add(std::string_view s) {
+        uint32_t size = s.size();
+        sha.update(llvm::ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(&size), sizeof(size)));
+        sha.update(llvm::StringRef(s));
+    }
+    template <typename T>
+    static std::string_view bytes(const T& value) {
+        return std::string_view(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void add(const PrototypeAST& proto) {
+        add(proto.Name.Text);
+        add(proto.ReturnType);
+        add(static_cast<uint8_t>(proto.Args.size()));
+        for (const auto& arg : proto.Args) {
+            add(arg.first);
+            add(arg.second.Text);
+        }
+    }
+
+    void visit(NumberExpr& ast) {
+        add(0);
+        add(static_cast<uint8_t>(ast.Type));
+        add(bytes(ast.IntValue));
+        add(bytes(ast.FloatValue));
+    }
+    void visit(StringExpr& ast) { add(1); add(ast.Value); }
+    void visit(BoolExpr& ast) { add(2); add(ast.Value); }
+    void visit(VariableExpr& ast) { add(3); add(ast.Name.Text); }
+    void visit(BinaryExpr& ast) { add(4); add(static_cast<uint8_t>(ast.Op)); visit(*ast.LHS); visit(*ast.RHS); }
+    void visit(UnaryExpr& ast) { add(5); add(static_cast<uint8_t>(ast.Op)); visit(*ast.RHS); }
+    void visit(CallExpr& ast) {
+        add(6);
+        add(ast.Callee.Text);
+        callees.push_back(ast.Callee.Text);
+        visitList(ast.Args);
+    }
+    void visit(IndexExpr& ast) { add(7); visit(*ast.Array); visit(*ast.Index); }
+    void visit(VectorExpr& ast) { add(8); add(ast.Type); visitList(ast.Lanes); }
+
+    void visit(BlockStmt& ast) {
+        add(16);
+        add(static_cast<uint8_t>(ast.Statements.size()));
+        for (auto* stmt : ast.Statements) {
+            visit(*stmt);
+        }
+        add(17);
+    }
+    void visit(ReturnStmt& ast) { add(18); visitOptional(ast.Value); }
+    void visit(PrintStmt& ast) { add(19); visit(*ast.Format); visitList(ast.Args); }
+    void visit(ExprStmt& ast) { add(20); visit(*ast.Expression); }
+    void visit(ScanStmt& ast) { add(21); visit(*ast.Var); }
+    void visit(VarDeclStmt& ast) {
+        add(22);
+        add(ast.VarType);
+        add(ast.VarName.Text);
+        visitOptional(ast.Init);
+        visitOptional(ast.ArraySize);
+    }
+    void visit(IfStmt& ast) {
+        add(23);
+        visit(*ast.Condition);
+        visit(*ast.ThenBranch);
+        add(ast.ElseBranch != nullptr);
+        if (ast.ElseBranch) {
+            visit(*ast.ElseBranch);
+        }
+    }
+    void visit(WhileStmt& ast) { add(24); visit(*ast.Condition); visit(*ast.Body); }
+    void visit(AssignStmt& ast) { add(25); visit(*ast.Target); visit(*ast.Value); }
+    void visit(ForStmt& ast) {
+        add(26);
+        visitOptional(ast.Init);
+        visitOptional(ast.Condition);
+        visitOptional(ast.Step);
+        visit(*ast.Body);
+    }
+
+private:
+    void visitOptional(Expr* expr) {
+        add(expr != nullptr);
+        if (expr) {
+            visit(*expr);
+        }
+    }
+    void visitOptional(Stmt* stmt) {
+        add(stmt != nullptr);
+        if (stmt) {
+            visit(*stmt);
+        }
+    }
+    void visitList(std::span<Expr*> exprs) {
+        add(static_cast<uint8_t>(exprs.size()));
+        for (auto* expr : exprs) {
+            visit(*expr);
+        }
+    }
+};
+
+} // namespace
+
+FunctionCache::FunctionCache(std::string directory, uint64_t maxSizeBytes)
+    : directory(std::move(directory)), maxSizeBytes(maxSizeBytes) {}
+
+bool FunctionCache::open() {
+    if (std::error_code EC = llvm::sys::fs::create_directories(directory)) {
+        llvm::errs() << "Could not create cache directory " << directory << ": " << EC.message() << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::string FunctionCache::key(FunctionAST& func, const llvm::StringMap<const PrototypeAST*>& protos, unsigned optLevel,
+                               const TargetSpec& target, const ProgramLinkage* linkage) const {
+    FunctionHasher hasher;
+    hasher.add(CacheVersion);
+    hasher.add(LLVM_VERSION_STRING);
+    hasher.add(target.triple);
+    hasher.add(target.cpu);
+    hasher.add(target.features);
+    hasher.add(static_cast<uint8_t>(optLevel));
+    auto addSignature = [&](const PrototypeAST& proto) {
+        hasher.add(proto);
+        hasher.add(static_cast<uint8_t>(linkage && linkage->isInternal(llvm::StringRef(proto.Name.Text))));
+    };
+    addSignature(*func.Proto);
+    hasher.visit(*func.Body);
+
+    // Callees only contribute their signatures: functions are optimized one
+    // at a time, so a callee's body can't change the caller's IR.
+    std::sort(hasher.callees.begin(), hasher.callees.end());
+    hasher.callees.erase(std::unique(hasher.callees.begin(), hasher.callees.end()), hasher.callees.end());
+    for (std::string_view callee : hasher.callees) {
+        auto it = protos.find(llvm::StringRef(callee));
+        if (it != protos.end()) {
+            addSignature(*it->second);
+        }
+    }
+    return llvm::toHex(hasher.sha.final(), true);
+}
+
+std::string FunctionCache::entryPath(const std::string& key) const {
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, EntryPrefix + key);
+    return std::string(path);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> FunctionCache::lookup(const std::string& key) {
+    std::string path = entryPath(key);
+    int fd;
+    if (llvm::sys::fs::openFileForRead(path, fd)) {
+        ++missCount;
+        return nullptr;
+    }
+
+    auto buffer = llvm::MemoryBuffer::getOpenFile(llvm::sys::fs::convertFDToNativeFile(fd), path, -1);
+    // Pruning evicts by access time, which noatime mounts never update.
+    llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    if (!buffer) {
+        ++missCount;
+        return nullptr;
+    }
+    ++hitCount;
+    return std::move(*buffer);
+}
+
+void FunctionCache::store(const std::string& key, llvm::StringRef bitcode) {
+    llvm::SmallString<128> model(directory);
+    llvm::sys::path::append(model, "tmp-%%%%%%%%");
+    auto temp = llvm::sys::fs::TempFile::create(model);
+    if (!temp) {
+        // The cache is best effort; the function was compiled either way.
+        llvm::consumeError(temp.takeError());
+        return;
+    }
+
+    {
+        llvm::raw_fd_ostream out(temp->FD, false);
+        out << bitcode;
+    }
+    if (auto err = temp->keep(entryPath(key))) {
+        llvm::consumeError(std::move(err));
+        llvm::consumeError(temp->discard());
+    }
+}
+
+void FunctionCache::prune() {
+    llvm::CachePruningPolicy policy;
+    policy.Interval = std::chrono::seconds(0);
+    policy.MaxSizeBytes = maxSizeBytes;
+    llvm::pruneCache(directory, policy);
+}
@@ -0,0 +1,116 @@
+#include "callgraph.h"
+#include "visitor.h"
+
+namespace {
+
+// Collects the callee of every call in a function body.
+class CalleeCollector : public ASTVisitor<CalleeCollector> {
+public:
+    std::vector<std::string_view>& callees;
+    explicit CalleeCollector(std::vector<std::string_view>& callees) : callees(callees) {}
+
+    using ASTVisitor::visit;
+
+    void visit(NumberExpr&) {}
+    void visit(StringExpr&) {}
+    void visit(BoolExpr&) {}
+    void visit(VariableExpr&) {}
+    void visit(BinaryExpr& ast) { visit(*ast.LHS); visit(*ast.RHS); }
+    void visit(UnaryExpr& ast) { visit(*ast.RHS); }
+    void visit(CallExpr& ast) {
+        callees.push_back(ast.Callee.Text);
+        for (auto* arg : ast.Args) {
+            visit(*arg);
+        }
+    }
+    void visit(IndexExpr& ast) { visit(*ast.Index); }
+    void visit(VectorExpr& ast) {
+        for (auto* lane : ast.Lanes) {
+            visit(*lane);
+        }
+    }
+
+    void visit(BlockStmt& ast) {
+        for (auto* stmt : ast.Statements) {
+            visit(*stmt);
+        }
+    }
+    void visit(ReturnStmt& ast) {
+        if (ast.Value) visit(*ast.Value);
+    }
+    void visit(PrintStmt& ast) {
+        visit(*ast.Format);
+        for (auto* arg : ast.Args) {
+            visit(*arg);
+        }
+    }
+    void visit(ExprStmt& ast) { visit(*ast.Expression); }
+    void visit(ScanStmt&) {}
+    void visit(VarDeclStmt& ast) {
+        if (ast.Init) visit(*ast.Init);
+        if (ast.ArraySize) visit(*ast.ArraySize);
+    }
+    void visit(IfStmt& ast) {
+        visit(*ast.Condition);
+        visit(*ast.ThenBranch);
+        if (ast.ElseBranch) visit(*ast.ElseBranch);
+    }
+    void visit(WhileStmt& ast) { visit(*ast.Condition); visit(*ast.Body); }
+    void visit(AssignStmt& ast) { visit(*ast.Target); visit(*ast.Value); }
+    void visit(ForStmt& ast) {
+        if (ast.Init) visit(*ast.Init);
+        if (ast.Condition) visit(*ast.Condition);
+        if (ast.Step) visit(*ast.Step);
+        visit(*ast.Body);
+    }
+};
+
+} // namespace
+
+void CallGraph::addModule(ModuleAST& ast, unsigned unit) {
+    for (auto* func : ast.Functions) {
+        Node& node = nodes[func->Proto->Name.Text];
+        node.unit = unit;
+        CalleeCollector(node.callees).visit(*func->Body);
+    }
+}
+
+ProgramLinkage CallGraph::link(const std::vector<std::string>& exports) const {
+    ProgramLinkage result;
+    for (const auto& node : nodes) {
+        result.defined.insert(node.first());
+    }
+
+    std::vector<llvm::StringRef> worklist;
+    auto addRoot = [&](llvm::StringRef name) {
+        result.external.insert(name);
+        if (result.defined.count(name) && result.live.insert(name).second) {
+            worklist.push_back(name);
+        }
+    };
+    addRoot("main");
+    for (const auto& name : exports) {
+        addRoot(name);
+    }
+
+    while (!worklist.empty()) {
+        const Node& node = nodes.find(worklist.back())->second;
+        worklist.pop_back();
+        for (std::string_view calleeName : node.callees) {
+            llvm::StringRef callee(calleeName);
+            auto it = nodes.find(callee);
+            if (it == nodes.end()) {
+                continue; // imported or unknown, left to codegen
+            }
+            // Calls across inputs go through the linker, so the callee has
+            // to stay visible there.
+            if (it->second.unit != node.unit) {
+                result.external.insert(callee);
+            }
+            if (result.live.insert(callee).second) {
+                worklist.push_back(it->first());
+            }
+        }
+    }
+    return result;
+}
@@ -1,17 +1,352 @@
 #include "codegen.h"
+#include "cat_runtime.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
 
-CodeGen::CodeGen() {
+// Arrays with a constant element count up to this many bytes are allocated
+// on the stack; larger or variable-sized ones on the heap.
+static const uint64_t StackArrayLimit = 64 * 1024;
+
+// Builtin horizontal reductions, see visitReduction.
+static bool isReduction(std::string_view name) {
+    return name == "reduce_add" || name == "reduce_min" || name == "reduce_max" || name == "any" || name == "all";
+}
+
+// Target registration isn't thread-safe, and units may be compiled on
+// several threads at once.
+static void initializeNativeTarget() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+
+CodeGen::CodeGen(const TargetSpec& target) : target(target) {
     context = std::make_unique<llvm::LLVMContext>();
     module = std::make_unique<llvm::Module>("CatLang", *context);
     builder = std::make_unique<llvm::IRBuilder<>>(*context);
+    getTargetMachine();
+}
+
+void CodeGen::generate(ModuleAST& ast, unsigned jobs) {
+    size_t count = ast.Functions.size();
+    if (jobs <= 1 || count < 2) {
+        visit(ast);
+        internalize();
+        return;
+    }
+
+    // Contexts can't share IR, so each worker hands its chunk back as bitcode.
+    size_t chunks = std::min<size_t>(jobs, count);
+    std::vector<llvm::SmallVector<char, 0>> bitcode(chunks);
+    {
+        llvm::ThreadPool pool(llvm::hardware_concurrency(chunks));
+        for (size_t c = 0; c < chunks; ++c) {
+            pool.async([&, c] {
+                CodeGen worker(target);
+                worker.linkage = linkage;
+                for (auto* proto : externalProtos) {
+                    worker.declare(*proto);
+                }
+                worker.declarePrototypes(ast);
+                for (size_t i = count * c / chunks, e = count * (c + 1) / chunks; i < e; ++i) {
+                    worker.visit(*ast.Functions[i]);
+                }
+                llvm::raw_svector_ostream os(bitcode[c]);
+                llvm::WriteBitcodeToFile(*worker.module, os);
+            });
+        }
+        pool.wait();
+    }
+
+    // Declaring everything first pins the functions to source order; linking
+    // the chunks in order then fills in the bodies deterministically.
+    declarePrototypes(ast);
+    for (auto& chunk : bitcode) {
+        linkBitcode(llvm::StringRef(chunk.data(), chunk.size()), "chunk");
+    }
+    mergeStringConstants();
+    internalize();
+}
+
+void CodeGen::declare(PrototypeAST& proto) {
+    // Internal functions of other inputs are never called from this one.
+    bool internal = linkage && linkage->isInternal(proto.Name.Text);
+    if (emits(proto) && !internal && !module->getFunction(proto.Name.Text)) {
+        visit(proto);
+        externalProtos.push_back(&proto);
+    }
+}
+
+bool CodeGen::generateCached(ModuleAST& ast, FunctionCache& cache, unsigned optLevel, unsigned jobs) {
+    llvm::StringMap<const PrototypeAST*> protos;
+    for (auto* proto : externalProtos) {
+        protos[proto->Name.Text] = proto;
+    }
+    for (auto* func : ast.Functions) {
+        protos[func->Proto->Name.Text] = func->Proto;
+    }
+
+    size_t count = ast.Functions.size();
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> bitcode(count);
+    auto compile = [&](size_t i) {
+        if (!emits(*ast.Functions[i]->Proto)) {
+            return;
+        }
+        std::string key = cache.key(*ast.Functions[i], protos, optLevel, target, linkage);
+        bitcode[i] = cache.lookup(key);
+        if (bitcode[i]) {
+            return;
+        }
+
+        CodeGen worker(target);
+        worker.linkage = linkage;
+        for (auto* proto : externalProtos) {
+            worker.declare(*proto);
+        }
+        worker.declarePrototypes(ast);
+        worker.visit(*ast.Functions[i]);
+        if (!worker.optimize(optLevel)) {
+            return;
+        }
+        // Only the declarations the body uses are hashed, so the rest must
+        // not end up in the entry.
+        worker.dropUnusedDeclarations();
+
+        llvm::SmallVector<char, 0> buffer;
+        llvm::raw_svector_ostream os(buffer);
+        llvm::WriteBitcodeToFile(*worker.module, os);
+        llvm::StringRef data(buffer.data(), buffer.size());
+        cache.store(key, data);
+        bitcode[i] = llvm::MemoryBuffer::getMemBufferCopy(data, "function");
+    };
+
+    if (jobs <= 1 || count < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            compile(i);
+        }
+    } else {
+        llvm::ThreadPool pool(llvm::hardware_concurrency(jobs));
+        for (size_t i = 0; i < count; ++i) {
+            pool.async(compile, i);
+        }
+        pool.wait();
+    }
+
+    declarePrototypes(ast);
+    bool ok = true;
+    for (size_t i = 0; i < count; ++i) {
+        if (emits(*ast.Functions[i]->Proto)) {
+            ok = bitcode[i] && linkBitcode(bitcode[i]->getBuffer(), "function") && ok;
+        }
+    }
+    mergeStringConstants();
+    internalize();
+    return ok;
+}
+
+bool CodeGen::link(CodeGen& other) {
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(*other.module, os);
+    other.module.reset();
+    if (!linkBitcode(llvm::StringRef(bitcode.data(), bitcode.size()), "unit")) {
+        return false;
+    }
+    mergeStringConstants();
+    return true;
+}
+
+bool CodeGen::linkBitcode(llvm::StringRef bitcode, llvm::StringRef name) {
+    auto other = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, name), *context);
+    if (!other) {
+        llvm::errs() << "Could not read generated " << name << ": " << llvm::toString(other.takeError()) << "\n";
+        return false;
+    }
+    if (llvm::Linker::linkModules(*module, std::move(*other))) {
+        logErrorV("Failed to link generated module");
+        return false;
+    }
+    return true;
+}
+
+bool CodeGen::emits(const PrototypeAST& proto) const {
+    return !linkage || linkage->emits(proto.Name.Text);
+}
+
+// Runs once the module holds every body it will get: internal functions
+// can't be declared, so workers and cache entries keep them external until
+// they are linked here.
+void CodeGen::internalize() {
+    if (!linkage) {
+        return;
+    }
+    for (auto& F : *module) {
+        if (!F.isDeclaration() && linkage->isInternal(F.getName())) {
+            F.setLinkage(llvm::GlobalValue::InternalLinkage);
+        }
+    }
+}
+
+// Every module pools its own literals, so linked chunks, cache entries and
+// units bring in copies of the same strings under renamed globals. Literals
+// are uniqued constants, so equal contents share one initializer.
+void CodeGen::mergeStringConstants() {
+    llvm::DenseMap<llvm::Constant*, llvm::GlobalVariable*> first;
+    for (auto& G : llvm::make_early_inc_range(module->globals())) {
+        if (!G.hasPrivateLinkage() || !G.isConstant() || !G.hasGlobalUnnamedAddr() || !G.hasInitializer()) {
+            continue;
+        }
+        auto [it, inserted] = first.try_emplace(G.getInitializer(), &G);
+        if (!inserted && it->second->getAlign() == G.getAlign()) {
+            G.replaceAllUsesWith(it->second);
+            G.eraseFromParent();
+        }
+    }
+    // Replacing uses rebuilt the constant expressions that point into the
+    // dropped globals.
+    strings.clear();
+}
+
+void CodeGen::dropUnusedDeclarations() {
+    for (auto& F : llvm::make_early_inc_range(*module)) {
+        if (F.isDeclaration() && F.use_empty()) {
+            F.eraseFromParent();
+        }
+    }
+}
+
+void CodeGen::declarePrototypes(ModuleAST& ast) {
+    for (auto* func : ast.Functions) {
+        if (emits(*func->Proto) && !module->getFunction(func->Proto->Name.Text)) {
+            visit(*func->Proto);
+        }
+    }
+}
+
+bool CodeGen::optimize(unsigned optLevel, bool timePasses, Pipeline pipeline) {
+    {
+        TimeReport::Scope timer(timeReport, "verify");
+        if (llvm::verifyModule(*module, &llvm::errs())) {
+            logErrorV("Module verification failed");
+            return false;
+        }
+    }
+    TimeReport::Scope timer(timeReport, "optimize");
+
+    llvm::TimePassesIsEnabled = timePasses;
+
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    llvm::PassInstrumentationCallbacks PIC;
+    llvm::StandardInstrumentations SI(false);
+    SI.registerCallbacks(PIC, &FAM);
+    if (timeReport) {
+        registerPassTimers(PIC);
+    }
+
+    llvm::PassBuilder PB(getTargetMachine(), llvm::PipelineTuningOptions(), pgo, &PIC);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::OptimizationLevel level;
+    switch (optLevel) {
+        case 0: level = llvm::OptimizationLevel::O0; break;
+        case 1: level = llvm::OptimizationLevel::O1; break;
+        case 2: level = llvm::OptimizationLevel::O2; break;
+        default: level = llvm::OptimizationLevel::O3; break;
+    }
+
+    // The ThinLTO pre-link pipeline leaves inlining and most loop work to
+    // the backends, which see the functions imported from other modules.
+    // Cached functions were simplified one at a time already, so the linked
+    // module only needs the inliner, which re-simplifies the callers it
+    // changes, and the late optimizations that profit from it.
+    llvm::ModulePassManager MPM;
+    if (level == llvm::OptimizationLevel::O0) {
+        MPM = PB.buildO0DefaultPipeline(level, pipeline == Pipeline::ThinLTOPreLink);
+    } else if (pipeline == Pipeline::ThinLTOPreLink) {
+        MPM = PB.buildThinLTOPreLinkDefaultPipeline(level);
+    } else if (pipeline == Pipeline::CachedLink) {
+        MPM.addPass(PB.buildInlinerPipeline(level, llvm::ThinOrFullLTOPhase::None));
+        MPM.addPass(PB.buildModuleOptimizationPipeline(level));
+    } else {
+        MPM = PB.buildPerModuleDefaultPipeline(level);
+    }
+    MPM.run(*module, MAM);
+
+    if (timePasses) {
+        llvm::reportAndResetTimings(&llvm::errs());
+        llvm::TimePassesIsEnabled = false;
+    }
+    return true;
 }
 
-void CodeGen::generate(ModuleAST& ast) {
-    visit(ast);
+// Times every pass and analysis run by the pipeline. Passes nest (adaptors
+// run function passes, the inliner runs the function pipeline), so each one
+// is charged only the time not spent in the passes it ran itself.
+void CodeGen::registerPassTimers(llvm::PassInstrumentationCallbacks& PIC) {
+    struct Frame {
+        TimeReport::Clock::time_point start;
+        TimeReport::Clock::duration children{};
+    };
+    auto stack = std::make_shared<std::vector<Frame>>();
+    auto begin = [stack](llvm::StringRef, llvm::Any) {
+        stack->push_back({TimeReport::Clock::now()});
+    };
+    auto end = [stack, report = timeReport](llvm::StringRef pass) {
+        Frame frame = stack->back();
+        stack->pop_back();
+        auto elapsed = TimeReport::Clock::now() - frame.start;
+        if (!stack->empty()) {
+            stack->back().children += elapsed;
+        }
+        if (!llvm::isSpecialPass(pass, {"PassManager", "PassAdaptor", "AnalysisManagerProxy"})) {
+            report->addPass(pass, elapsed - frame.children);
+        }
+    };
+
+    PIC.registerBeforeNonSkippedPassCallback(begin);
+    PIC.registerAfterPassCallback([end](llvm::StringRef pass, llvm::Any, const llvm::PreservedAnalyses&) { end(pass); });
+    PIC.registerAfterPassInvalidatedCallback([end](llvm::StringRef pass, const llvm::PreservedAnalyses&) { end(pass); });
+    PIC.registerBeforeAnalysisCallback(begin);
+    PIC.registerAfterAnalysisCallback([end](llvm::StringRef pass, llvm::Any) { end(pass); });
+}
+
+size_t CodeGen::instructionCount() const {
+    size_t count = 0;
+    for (const auto& F : *module) {
+        count += F.getInstructionCount();
+    }
+    return count;
 }
 
 void CodeGen::dump() {
@@ -31,57 +366,241 @@ bool CodeGen::writeToFile(const std::string& filename) {
     return true;
 }
 
+void CodeGen::writeThinLTOBitcode(llvm::raw_ostream& os, llvm::StringRef moduleName) {
+    // The backends need the target's data layout, and promoted internal
+    // functions are renamed after the source file, which must differ
+    // between inputs.
+    getTargetMachine();
+    module->setModuleIdentifier(moduleName);
+    module->setSourceFileName(moduleName);
+    llvm::ProfileSummaryInfo PSI(*module);
+    llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(*module, nullptr, &PSI);
+    llvm::WriteBitcodeToFile(*module, os, false, &index);
+}
+
+bool CodeGen::writeBitcodeFile(const std::string& filename, llvm::StringRef moduleName) {
+    std::error_code EC;
+    llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        llvm::errs() << "Could not open file: " << EC.message();
+        return false;
+    }
+
+    writeThinLTOBitcode(dest, moduleName);
+    return true;
+}
+
+bool CodeGen::emitNativeFile(const std::string& filename, bool assembly) {
+    llvm::TargetMachine* tm = getTargetMachine();
+    if (!tm) {
+        return false;
+    }
+
+    std::error_code EC;
+    llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        llvm::errs() << "Could not open file: " << EC.message();
+        return false;
+    }
+
+    llvm::legacy::PassManager pass;
+    auto fileType = assembly ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
+    if (tm->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+        logErrorV("Target machine can't emit a file of this type");
+        return false;
+    }
+
+    pass.run(*module);
+    dest.flush();
+    return true;
+}
+
+bool CodeGen::runJIT(const std::string& programName, const std::vector<std::string>& args, int& exitCode) {
+    initializeNativeTarget();
+
+    llvm::Function* mainFn = module->getFunction("main");
+    if (!mainFn || mainFn->isDeclaration()) {
+        logErrorV("No main function to run");
+        return false;
+    }
+    bool returnsInt = mainFn->getReturnType()->isIntegerTy(32);
+
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!jit) {
+        llvm::errs() << "Could not create JIT: " << llvm::toString(jit.takeError()) << "\n";
+        return false;
+    }
+
+    // The runtime is linked into the compiler statically, so its symbols are
+    // defined by address; libc resolves from the compiler process.
+    llvm::orc::SymbolMap runtime;
+    auto defineRuntime = [&](const char* name, auto* fn) {
+        runtime[(*jit)->mangleAndIntern(name)] = llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(fn), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    };
+    defineRuntime("cat_print_i32", &cat_print_i32);
+    defineRuntime("cat_print_f32", &cat_print_f32);
+    defineRuntime("cat_print_str", &cat_print_str);
+    defineRuntime("cat_printf", &cat_printf);
+    defineRuntime("cat_flush", &cat_flush);
+    defineRuntime("cat_scan_i32", &cat_scan_i32);
+    defineRuntime("cat_scan_f32", &cat_scan_f32);
+    defineRuntime("cat_scan_bool", &cat_scan_bool);
+    defineRuntime("cat_scan_str", &cat_scan_str);
+    if (auto err = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(runtime)))) {
+        llvm::errs() << "Could not define runtime symbols: " << llvm::toString(std::move(err)) << "\n";
+        return false;
+    }
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator) {
+        llvm::errs() << "Could not load host symbols: " << llvm::toString(generator.takeError()) << "\n";
+        return false;
+    }
+    (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+    module->setDataLayout((*jit)->getDataLayout());
+    llvm::orc::ThreadSafeModule tsm(std::move(module), std::move(context));
+    if (auto err = (*jit)->addIRModule(std::move(tsm))) {
+        llvm::errs() << "Could not add module to JIT: " << llvm::toString(std::move(err)) << "\n";
+        return false;
+    }
+
+    auto mainSym = (*jit)->lookup("main");
+    if (!mainSym) {
+        llvm::errs() << "Could not find main: " << llvm::toString(mainSym.takeError()) << "\n";
+        return false;
+    }
+
+    auto* mainPtr = llvm::jitTargetAddressToFunction<int (*)(int, char*[])>(mainSym->getAddress());
+    exitCode = llvm::orc::runAsMain(mainPtr, args, llvm::StringRef(programName));
+    if (!returnsInt) {
+        exitCode = 0;
+    }
+    cat_flush();
+    return true;
+}
+
 llvm::Value* CodeGen::logErrorV(const char* str) {
     fprintf(stderr, "Error: %s\n", str);
     return nullptr;
 }
 
-llvm::Type* CodeGen::getType(const std::string& typeName) {
+llvm::Type* CodeGen::getType(llvm::StringRef typeName) {
+    std::string_view element = arrayElementType(std::string_view(typeName.data(), typeName.size()));
+    if (!element.empty()) {
+        return getType(llvm::StringRef(element.data(), element.size()))->getPointerTo();
+    }
+    unsigned lanes;
+    element = vectorElementType(std::string_view(typeName.data(), typeName.size()), lanes);
+    if (!element.empty()) {
+        return llvm::FixedVectorType::get(getType(llvm::StringRef(element.data(), element.size())), lanes);
+    }
     if (typeName == "int") return builder->getInt32Ty();
     if (typeName == "float") return builder->getFloatTy();
     if (typeName == "bool") return builder->getInt1Ty();
+    if (typeName == "string") return builder->getInt8PtrTy();
     return builder->getVoidTy();
 }
 
-llvm::Function* CodeGen::getFunction(std::string name) {
+llvm::TargetMachine* CodeGen::getTargetMachine() {
+    if (targetMachine) {
+        return targetMachine.get();
+    }
+
+    initializeNativeTarget();
+
+    std::string error;
+    const llvm::Target* llvmTarget = llvm::TargetRegistry::lookupTarget(target.triple, error);
+    if (!llvmTarget) {
+        llvm::errs() << "Could not find target " << target.triple << ": " << error << "\n";
+        return nullptr;
+    }
+
+    llvm::TargetOptions options;
+    targetMachine.reset(llvmTarget->createTargetMachine(target.triple, target.cpu, target.features, options,
+                                                        llvm::Reloc::PIC_));
+    module->setTargetTriple(target.triple);
+    module->setDataLayout(targetMachine->createDataLayout());
+    return targetMachine.get();
+}
+
+llvm::Function* CodeGen::getFunction(llvm::StringRef name) {
     if (auto* F = module->getFunction(name)) {
         return F;
     }
-    if (name == "printf") {
-        llvm::Type* charPtrType = llvm::PointerType::get(builder->getInt8Ty(), 0);
-        llvm::FunctionType* ft = llvm::FunctionType::get(builder->getInt32Ty(), charPtrType, true);
-        return llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "printf", module.get());
+    // Buffered output and input, see runtime/cat_runtime.h
+    auto runtime = [&](llvm::Type* result, llvm::ArrayRef<llvm::Type*> params, bool vararg) {
+        llvm::FunctionType* ft = llvm::FunctionType::get(result, params, vararg);
+        auto* F = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, name, module.get());
+        F->setDoesNotThrow();
+        return F;
+    };
+    if (name == "cat_print_i32") {
+        return runtime(builder->getVoidTy(), builder->getInt32Ty(), false);
+    }
+    if (name == "cat_print_f32") {
+        return runtime(builder->getVoidTy(), builder->getFloatTy(), false);
+    }
+    if (name == "cat_print_str") {
+        return runtime(builder->getVoidTy(), {builder->getInt8PtrTy(), builder->getInt64Ty()}, false);
+    }
+    if (name == "cat_printf") {
+        return runtime(builder->getVoidTy(), builder->getInt8PtrTy(), true);
+    }
+    if (name == "cat_flush") {
+        return runtime(builder->getVoidTy(), {}, false);
+    }
+    if (name == "cat_scan_i32") {
+        return runtime(builder->getVoidTy(), builder->getInt32Ty()->getPointerTo(), false);
+    }
+    if (name == "cat_scan_f32") {
+        return runtime(builder->getVoidTy(), builder->getFloatTy()->getPointerTo(), false);
+    }
+    if (name == "cat_scan_bool") {
+        return runtime(builder->getVoidTy(), builder->getInt1Ty()->getPointerTo(), false);
+    }
+    if (name == "cat_scan_str") {
+        return runtime(builder->getVoidTy(), builder->getInt8PtrTy()->getPointerTo(), false);
     }
-    if (name == "scanf") {
-        llvm::Type* charPtrType = llvm::PointerType::get(builder->getInt8Ty(), 0);
-        llvm::FunctionType* ft = llvm::FunctionType::get(builder->getInt32Ty(), charPtrType, true);
-        return llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "scanf", module.get());
+    if (name == "calloc") {
+        llvm::FunctionType* ft = llvm::FunctionType::get(builder->getInt8PtrTy(), {builder->getInt64Ty(), builder->getInt64Ty()}, false);
+        return llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "calloc", module.get());
+    }
+    if (name == "free") {
+        llvm::FunctionType* ft = llvm::FunctionType::get(builder->getVoidTy(), builder->getInt8PtrTy(), false);
+        return llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "free", module.get());
     }
     return nullptr;
 }
 
-llvm::Value* CodeGen::visit(Expr& ast) {
-    if (auto* e = dynamic_cast<NumberExpr*>(&ast)) return visit(*e);
-    if (auto* e = dynamic_cast<StringExpr*>(&ast)) return visit(*e);
-    if (auto* e = dynamic_cast<BoolExpr*>(&ast)) return visit(*e);
-    if (auto* e = dynamic_cast<VariableExpr*>(&ast)) return visit(*e);
-    if (auto* e = dynamic_cast<BinaryExpr*>(&ast)) return visit(*e);
-    if (auto* e = dynamic_cast<UnaryExpr*>(&ast)) return visit(*e);
-    if (auto* e = dynamic_cast<CallExpr*>(&ast)) return visit(*e);
-    return logErrorV("Unknown expression type");
+// Literals are pooled per module, so every print of "%d" or "\n" shares one
+// global.
+llvm::Constant* CodeGen::stringConstant(llvm::StringRef text) {
+    llvm::Constant*& pooled = strings[text];
+    if (!pooled) {
+        llvm::Constant* init = llvm::ConstantDataArray::getString(*context, text);
+        auto* global = new llvm::GlobalVariable(*module, init->getType(), true, llvm::GlobalValue::PrivateLinkage,
+                                                init, ".str");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(1));
+        llvm::Constant* zero = builder->getInt32(0);
+        pooled = llvm::ConstantExpr::getInBoundsGetElementPtr(init->getType(), global, llvm::ArrayRef<llvm::Constant*>{zero, zero});
+    }
+    return pooled;
 }
 
 llvm::Value* CodeGen::visit(NumberExpr& ast) {
     if (ast.Type == TokenType::INT_LITERAL) {
-        return llvm::ConstantInt::get(*context, llvm::APInt(32, std::stoll(ast.Value), true));
+        return builder->getInt32(ast.IntValue);
     } else if (ast.Type == TokenType::FLOAT_LITERAL) {
-        return llvm::ConstantFP::get(*context, llvm::APFloat(std::stod(ast.Value)));
+        return llvm::ConstantFP::get(builder->getFloatTy(), ast.FloatValue);
     }
     return logErrorV("Unknown number type");
 }
 
 llvm::Value* CodeGen::visit(StringExpr& ast) {
-    return builder->CreateGlobalString(ast.Value);
+    return stringConstant(llvm::StringRef(ast.Value.data(), ast.Value.size()));
 }
 
 llvm::Value* CodeGen::visit(BoolExpr& ast) {
@@ -93,11 +612,16 @@ llvm::Value* CodeGen::visit(BoolExpr& ast) {
 }
 
 llvm::Value* CodeGen::visit(VariableExpr& ast) {
-    llvm::AllocaInst* a = namedValues[ast.Name];
+    llvm::AllocaInst* a = namedValues.lookup(ast.Name.Id);
     if (!a) {
         return logErrorV("Unknown variable name");
     }
-    return builder->CreateLoad(a->getAllocatedType(), a, ast.Name.c_str());
+    // Stack arrays are passed on as a pointer to their first element, like
+    // heap arrays and array parameters.
+    if (auto* arrayType = llvm::dyn_cast<llvm::ArrayType>(a->getAllocatedType())) {
+        return builder->CreateConstInBoundsGEP2_64(arrayType, a, 0, 0, llvm::StringRef(ast.Name.Text));
+    }
+    return builder->CreateLoad(a->getAllocatedType(), a, llvm::StringRef(ast.Name.Text));
 }
 
 llvm::Value* CodeGen::visit(BinaryExpr& ast) {
@@ -107,26 +631,50 @@ llvm::Value* CodeGen::visit(BinaryExpr& ast) {
         return nullptr;
     }
 
-    if (L->getType()->isIntegerTy()) {
-        if (ast.Op == "+") return builder->CreateAdd(L, R, "addtmp");
-        if (ast.Op == "-") return builder->CreateSub(L, R, "subtmp");
-        if (ast.Op == "*") return builder->CreateMul(L, R, "multmp");
-        if (ast.Op == "<") return builder->CreateICmpULT(L, R, "cmptmp");
-        if (ast.Op == "==") return builder->CreateICmpEQ(L, R, "cmptmp");
-        if (ast.Op == "!=") return builder->CreateICmpNE(L, R, "cmptmp");
-        if (ast.Op == "<=") return builder->CreateICmpULE(L, R, "cmptmp");
-        if (ast.Op == ">=") return builder->CreateICmpUGE(L, R, "cmptmp");
-        if (ast.Op == "&&") return builder->CreateAnd(L, R, "andtmp");
-        if (ast.Op == "||") return builder->CreateOr(L, R, "ortmp");
+    // A scalar next to a vector applies to every lane.
+    auto* LV = llvm::dyn_cast<llvm::FixedVectorType>(L->getType());
+    auto* RV = llvm::dyn_cast<llvm::FixedVectorType>(R->getType());
+    if (LV && !RV && R->getType() == LV->getElementType()) {
+        R = builder->CreateVectorSplat(LV->getNumElements(), R, "splat");
+    } else if (RV && !LV && L->getType() == RV->getElementType()) {
+        L = builder->CreateVectorSplat(RV->getNumElements(), L, "splat");
+    }
+    if (L->getType() != R->getType()) {
+        return logErrorV("Operands of a binary operator have different types");
+    }
+
+    // Vectors use the same instructions, applied lane by lane.
+    if (L->getType()->isIntOrIntVectorTy()) {
+        switch (ast.Op) {
+            case BinaryOp::Add: return builder->CreateAdd(L, R, "addtmp");
+            case BinaryOp::Sub: return builder->CreateSub(L, R, "subtmp");
+            case BinaryOp::Mul: return builder->CreateMul(L, R, "multmp");
+            case BinaryOp::Div: return builder->CreateSDiv(L, R, "divtmp");
+            case BinaryOp::Less: return builder->CreateICmpSLT(L, R, "cmptmp");
+            case BinaryOp::Greater: return builder->CreateICmpSGT(L, R, "cmptmp");
+            case BinaryOp::LessEqual: return builder->CreateICmpSLE(L, R, "cmptmp");
+            case BinaryOp::GreaterEqual: return builder->CreateICmpSGE(L, R, "cmptmp");
+            case BinaryOp::Equal: return builder->CreateICmpEQ(L, R, "cmptmp");
+            case BinaryOp::NotEqual: return builder->CreateICmpNE(L, R, "cmptmp");
+            case BinaryOp::And: return builder->CreateAnd(L, R, "andtmp");
+            case BinaryOp::Or: return builder->CreateOr(L, R, "ortmp");
+        }
     } else {
-        if (ast.Op == "+") return builder->CreateFAdd(L, R, "addtmp");
-        if (ast.Op == "-") return builder->CreateFSub(L, R, "subtmp");
-        if (ast.Op == "*") return builder->CreateFMul(L, R, "multmp");
-        if (ast.Op == "<") return builder->CreateFCmpULT(L, R, "cmptmp");
-        if (ast.Op == "==") return builder->CreateFCmpUEQ(L, R, "cmptmp");
-        if (ast.Op == "!=") return builder->CreateFCmpUNE(L, R, "cmptmp");
-        if (ast.Op == "<=") return builder->CreateFCmpULE(L, R, "cmptmp");
-        if (ast.Op == ">=") return builder->CreateFCmpUGE(L, R, "cmptmp");
+        switch (ast.Op) {
+            case BinaryOp::Add: return builder->CreateFAdd(L, R, "addtmp");
+            case BinaryOp::Sub: return builder->CreateFSub(L, R, "subtmp");
+            case BinaryOp::Mul: return builder->CreateFMul(L, R, "multmp");
+            case BinaryOp::Div: return builder->CreateFDiv(L, R, "divtmp");
+            case BinaryOp::Less: return builder->CreateFCmpULT(L, R, "cmptmp");
+            case BinaryOp::Greater: return builder->CreateFCmpUGT(L, R, "cmptmp");
+            case BinaryOp::LessEqual: return builder->CreateFCmpULE(L, R, "cmptmp");
+            case BinaryOp::GreaterEqual: return builder->CreateFCmpUGE(L, R, "cmptmp");
+            case BinaryOp::Equal: return builder->CreateFCmpUEQ(L, R, "cmptmp");
+            case BinaryOp::NotEqual: return builder->CreateFCmpUNE(L, R, "cmptmp");
+            case BinaryOp::And:
+            case BinaryOp::Or:
+                break;
+        }
     }
     return logErrorV("invalid binary operator");
 }
@@ -135,16 +683,24 @@ llvm::Value* CodeGen::visit(UnaryExpr& ast) {
     llvm::Value* operand = visit(*ast.RHS);
     if (!operand) return nullptr;
 
-    if (ast.Op == "!") {
-        return builder->CreateNot(operand, "nottmp");
+    switch (ast.Op) {
+        case UnaryOp::Not: return builder->CreateNot(operand, "nottmp");
+        case UnaryOp::Neg:
+            if (operand->getType()->isFPOrFPVectorTy()) {
+                return builder->CreateFNeg(operand, "negtmp");
+            }
+            return builder->CreateNeg(operand, "negtmp");
     }
 
     return logErrorV("invalid unary operator");
 }
 
 llvm::Value* CodeGen::visit(CallExpr& ast) {
-    llvm::Function* calleeF = getFunction(ast.Callee);
+    llvm::Function* calleeF = getFunction(ast.Callee.Text);
     if (!calleeF) {
+        if (isReduction(ast.Callee.Text)) {
+            return visitReduction(ast);
+        }
         return logErrorV("Unknown function referenced");
     }
 
@@ -160,22 +716,154 @@ llvm::Value* CodeGen::visit(CallExpr& ast) {
         }
     }
 
-    return builder->CreateCall(calleeF, argsV, "calltmp");
+    // Calls to void functions (e.g. ones filling an array) can't be named.
+    llvm::CallInst* call = builder->CreateCall(calleeF, argsV, calleeF->getReturnType()->isVoidTy() ? "" : "calltmp");
+    call->setCallingConv(calleeF->getCallingConv());
+    return call;
+}
+
+// Horizontal reductions of one vector to a scalar. They are only builtins
+// while the program defines no function of the same name. Float sums may
+// be reassociated, so they reduce pairwise like integer ones.
+llvm::Value* CodeGen::visitReduction(CallExpr& ast) {
+    if (ast.Args.size() != 1) {
+        return logErrorV("Reductions take a single vector");
+    }
+    llvm::Value* vector = visit(*ast.Args[0]);
+    if (!vector) {
+        return nullptr;
+    }
+    auto* vectorType = llvm::dyn_cast<llvm::FixedVectorType>(vector->getType());
+    if (!vectorType) {
+        return logErrorV("Reductions take a single vector");
+    }
+
+    llvm::Type* element = vectorType->getElementType();
+    bool isFloat = element->isFloatTy();
+    bool isBool = element->isIntegerTy(1);
+    std::string_view name = ast.Callee.Text;
+    if (name == "any" || name == "all") {
+        if (!isBool) {
+            return logErrorV("any and all take a bool vector");
+        }
+        return name == "any" ? builder->CreateOrReduce(vector) : builder->CreateAndReduce(vector);
+    }
+    if (isBool) {
+        return logErrorV("Bool vectors can only be reduced with any and all");
+    }
+    if (name == "reduce_add") {
+        if (!isFloat) {
+            return builder->CreateAddReduce(vector);
+        }
+        llvm::CallInst* sum = builder->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(element), vector);
+        sum->setHasAllowReassoc(true);
+        return sum;
+    }
+    bool isMax = name == "reduce_max";
+    if (isFloat) {
+        return isMax ? builder->CreateFPMaxReduce(vector) : builder->CreateFPMinReduce(vector);
+    }
+    return isMax ? builder->CreateIntMaxReduce(vector, true) : builder->CreateIntMinReduce(vector, true);
+}
+
+llvm::Value* CodeGen::visit(VectorExpr& ast) {
+    auto* vectorType = llvm::cast<llvm::FixedVectorType>(getType(llvm::StringRef(ast.Type)));
+    unsigned lanes = vectorType->getNumElements();
+    if (ast.Lanes.size() != 1 && ast.Lanes.size() != lanes) {
+        return logErrorV("A vector needs one value or one per lane");
+    }
+
+    std::vector<llvm::Value*> values;
+    for (auto* lane : ast.Lanes) {
+        values.push_back(visit(*lane));
+        if (!values.back()) {
+            return nullptr;
+        }
+        if (values.back()->getType() != vectorType->getElementType()) {
+            return logErrorV("Vector lane has the wrong type");
+        }
+    }
+    if (values.size() == 1) {
+        return builder->CreateVectorSplat(lanes, values[0], "splat");
+    }
+    // Constant lanes fold into a constant vector.
+    llvm::Value* vector = llvm::PoisonValue::get(vectorType);
+    for (unsigned i = 0; i < lanes; ++i) {
+        vector = builder->CreateInsertElement(vector, values[i], builder->getInt32(i), "vecinit");
+    }
+    return vector;
+}
+
+// Indices are sign-extended to 64 bits and the GEPs are inbounds, so the
+// optimizer may assume every access stays within its array.
+llvm::Value* CodeGen::elementPointer(IndexExpr& ast, llvm::Type*& elementType) {
+    llvm::AllocaInst* a = namedValues.lookup(ast.Array->Name.Id);
+    if (!a) {
+        return logErrorV("Unknown variable name");
+    }
+    llvm::Value* index = visit(*ast.Index);
+    if (!index) {
+        return nullptr;
+    }
+    if (!index->getType()->isIntegerTy(32)) {
+        return logErrorV("Array index must be an int");
+    }
+    index = builder->CreateSExt(index, builder->getInt64Ty(), "idxprom");
+
+    if (arrayElementType(namedTypes.lookup(ast.Array->Name.Id)).empty()) {
+        return logErrorV("Indexing a variable that is not an array");
+    }
+    llvm::Type* allocated = a->getAllocatedType();
+    if (auto* arrayType = llvm::dyn_cast<llvm::ArrayType>(allocated)) {
+        elementType = arrayType->getElementType();
+        return builder->CreateInBoundsGEP(arrayType, a, {builder->getInt64(0), index}, "arrayidx");
+    }
+    if (allocated->isPointerTy()) {
+        elementType = allocated->getPointerElementType();
+        llvm::Value* base = builder->CreateLoad(allocated, a, llvm::StringRef(ast.Array->Name.Text));
+        return builder->CreateInBoundsGEP(elementType, base, index, "arrayidx");
+    }
+    return logErrorV("Indexing a variable that is not an array");
 }
 
-void CodeGen::visit(Stmt& ast) {
-    if (auto* s = dynamic_cast<BlockStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<ReturnStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<PrintStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<ExprStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<ScanStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<VarDeclStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<IfStmt*>(&ast)) return visit(*s);
-    if (auto* s = dynamic_cast<WhileStmt*>(&ast)) return visit(*s);
+// Constant lanes are checked here; a computed lane outside the vector
+// reads or writes an undefined value, as it does in LLVM.
+llvm::Value* CodeGen::laneIndex(Expr& index, llvm::FixedVectorType* vectorType) {
+    llvm::Value* lane = visit(index);
+    if (!lane) {
+        return nullptr;
+    }
+    if (!lane->getType()->isIntegerTy(32)) {
+        return logErrorV("Vector lane must be an int");
+    }
+    auto* constant = llvm::dyn_cast<llvm::ConstantInt>(lane);
+    if (constant && constant->getZExtValue() >= vectorType->getNumElements()) {
+        return logErrorV("Vector lane out of range");
+    }
+    return lane;
+}
+
+llvm::Value* CodeGen::visit(IndexExpr& ast) {
+    llvm::AllocaInst* a = namedValues.lookup(ast.Array->Name.Id);
+    if (a && a->getAllocatedType()->isVectorTy()) {
+        llvm::Value* lane = laneIndex(*ast.Index, llvm::cast<llvm::FixedVectorType>(a->getAllocatedType()));
+        if (!lane) {
+            return nullptr;
+        }
+        llvm::Value* vector = builder->CreateLoad(a->getAllocatedType(), a, llvm::StringRef(ast.Array->Name.Text));
+        return builder->CreateExtractElement(vector, lane, "lane");
+    }
+
+    llvm::Type* elementType;
+    llvm::Value* ptr = elementPointer(ast, elementType);
+    if (!ptr) {
+        return nullptr;
+    }
+    return builder->CreateLoad(elementType, ptr, "arrayelem");
 }
 
 void CodeGen::visit(BlockStmt& ast) {
-    for (auto& stmt : ast.Statements) {
+    for (auto* stmt : ast.Statements) {
         visit(*stmt);
     }
 }
@@ -185,36 +873,108 @@ void CodeGen::visit(ReturnStmt& ast) {
 }
 
 void CodeGen::visit(PrintStmt& ast) {
-    llvm::Function* printfFn = getFunction("printf");
-    std::vector<llvm::Value*> args;
+    if (ast.Format->Kind != ExprKind::String) {
+        printValue(visit(*ast.Format));
+        return;
+    }
 
-    if (auto* se = dynamic_cast<StringExpr*>(ast.Format.get())) {
-        args.push_back(builder->CreateGlobalString(se->Value));
-        for (auto& arg : ast.Args) {
-            args.push_back(visit(*arg));
+    // Arguments are evaluated up front, in order, whichever way the format
+    // is printed.
+    std::vector<llvm::Value*> values;
+    for (auto* arg : ast.Args) {
+        llvm::Value* value = visit(*arg);
+        if (!value) {
+            return;
         }
-    } else {
-        llvm::Value* valueToPrint = visit(*ast.Format);
-        llvm::Type* type = valueToPrint->getType();
-        std::string format;
-
-        if (type->isIntegerTy(32)) {
-            format = "%d";
-        } else if (type->isFloatTy()) {
-            format = "%f";
-        } else if (type->isIntegerTy(1)) {
-            format = "%d";
-        } else if (type->isPointerTy() && type->getContainedType(0)->isIntegerTy(8)) {
-            format = "%s";
+        values.push_back(value);
+    }
+    std::string_view format = static_cast<StringExpr&>(*ast.Format).Value;
+    if (printSplit(format, ast.Args, values)) {
+        return;
+    }
+
+    // cat_printf is variadic, so its arguments get the C default promotions.
+    std::vector<llvm::Value*> args = {stringConstant(llvm::StringRef(format.data(), format.size()))};
+    for (llvm::Value* value : values) {
+        if (value->getType()->isFloatTy()) {
+            value = builder->CreateFPExt(value, builder->getDoubleTy());
+        } else if (value->getType()->isIntegerTy(1)) {
+            value = builder->CreateZExt(value, builder->getInt32Ty());
+        }
+        args.push_back(value);
+    }
+    builder->CreateCall(getFunction("cat_printf"), args);
+}
+
+// Splits a literal format at compile time into runtime calls: text between
+// conversions and string literal arguments are printed as one piece, %d/%i,
+// %f and other %s values through their own formatters. Formats with flags,
+// widths, precisions or other conversions, or arguments that don't match,
+// return false without emitting anything.
+bool CodeGen::printSplit(std::string_view format, std::span<Expr*> args, const std::vector<llvm::Value*>& values) {
+    // Each piece is some text followed by an optional value
+    std::vector<std::pair<std::string, llvm::Value*>> pieces(1);
+    size_t next = 0;
+    for (size_t i = 0; i < format.size(); ++i) {
+        if (format[i] != '%') {
+            pieces.back().first += format[i];
+            continue;
+        }
+        if (++i == format.size()) {
+            return false;
+        }
+        char conversion = format[i];
+        if (conversion == '%') {
+            pieces.back().first += '%';
+            continue;
+        }
+        if (next == values.size()) {
+            return false;
+        }
+        Expr* arg = args[next];
+        llvm::Value* value = values[next++];
+        llvm::Type* type = value->getType();
+        if (conversion == 's' && arg->Kind == ExprKind::String) {
+            pieces.back().first += static_cast<StringExpr&>(*arg).Value;
+        } else if (((conversion == 'd' || conversion == 'i') && (type->isIntegerTy(32) || type->isIntegerTy(1))) ||
+                   (conversion == 'f' && type->isFloatTy()) || (conversion == 's' && type == builder->getInt8PtrTy())) {
+            pieces.back().second = value;
+            pieces.emplace_back();
         } else {
-            logErrorV("Printing expressions of this type is not supported.");
-            return;
+            return false;
         }
-        args.push_back(builder->CreateGlobalString(format));
-        args.push_back(valueToPrint);
+    }
+    if (next != values.size()) {
+        return false;
     }
 
-    builder->CreateCall(printfFn, args);
+    for (auto& [text, value] : pieces) {
+        if (!text.empty()) {
+            builder->CreateCall(getFunction("cat_print_str"), {stringConstant(text), builder->getInt64(text.size())});
+        }
+        if (value) {
+            printValue(value);
+        }
+    }
+    return true;
+}
+
+void CodeGen::printValue(llvm::Value* value) {
+    if (!value) {
+        return;
+    }
+    llvm::Type* type = value->getType();
+    if (type->isIntegerTy(32)) {
+        builder->CreateCall(getFunction("cat_print_i32"), value);
+    } else if (type->isIntegerTy(1)) {
+        builder->CreateCall(getFunction("cat_print_i32"), builder->CreateZExt(value, builder->getInt32Ty()));
+    } else if (type->isFloatTy()) {
+        builder->CreateCall(getFunction("cat_print_f32"), value);
+    } else if (type->isPointerTy() && type->getContainedType(0)->isIntegerTy(8)) {
+        builder->CreateCall(getFunction("cat_printf"), {stringConstant("%s"), value});
+    } else {
+        logErrorV("Printing expressions of this type is not supported.");
+    }
 }
 
 void CodeGen::visit(ExprStmt& ast) {
@@ -222,47 +982,189 @@ void CodeGen::visit(ExprStmt& ast) {
 }
 
 void CodeGen::visit(ScanStmt& ast) {
-    llvm::AllocaInst* alloca = namedValues[ast.Var->Name];
+    llvm::AllocaInst* alloca = namedValues.lookup(ast.Var->Name.Id);
     if (!alloca) {
         logErrorV("Unknown variable name in scan");
         return;
     }
-    llvm::Function* scanfFn = getFunction("scanf");
     llvm::Type* varType = alloca->getAllocatedType();
-    std::string format;
+    llvm::StringRef reader;
 
     if (varType->isIntegerTy(32)) {
-        format = "%d";
+        reader = "cat_scan_i32";
     } else if (varType->isFloatTy()) {
-        format = "%f";
+        reader = "cat_scan_f32";
+    } else if (varType->isIntegerTy(1)) {
+        reader = "cat_scan_bool";
+    } else if (varType == builder->getInt8PtrTy()) {
+        reader = "cat_scan_str";
     } else {
         logErrorV("Scanning for this type is not supported.");
         return;
     }
 
-    llvm::Value* formatStr = builder->CreateGlobalString(format);
-    builder->CreateCall(scanfFn, {formatStr, alloca});
+    builder->CreateCall(getFunction(reader), alloca);
 }
 
 void CodeGen::visit(VarDeclStmt& ast) {
     llvm::Function* theFunction = builder->GetInsertBlock()->getParent();
     llvm::IRBuilder<> TmpB(&theFunction->getEntryBlock(), theFunction->getEntryBlock().begin());
-    llvm::AllocaInst* alloca = TmpB.CreateAlloca(getType(ast.VarType), 0, ast.VarName.c_str());
+    if (ast.ArraySize) {
+        declareArray(ast, TmpB);
+        return;
+    }
+    llvm::AllocaInst* alloca = TmpB.CreateAlloca(getType(ast.VarType), 0, llvm::StringRef(ast.VarName.Text));
 
     if (ast.Init) {
         llvm::Value* initVal = visit(*ast.Init);
         builder->CreateStore(initVal, alloca);
     }
 
-    namedValues[ast.VarName] = alloca;
+    namedValues[ast.VarName.Id] = alloca;
+    namedTypes[ast.VarName.Id] = ast.VarType;
+}
+
+// Heap arrays keep their pointer in a slot that starts out null. Running
+// the declaration again (in a loop) frees the previous allocation, and
+// whatever the slots hold is freed when the function returns.
+void CodeGen::declareArray(VarDeclStmt& ast, llvm::IRBuilder<>& entry) {
+    llvm::StringRef name(ast.VarName.Text);
+    namedTypes[ast.VarName.Id] = arrayTypeName(ast.VarType);
+    llvm::Type* elementType = getType(llvm::StringRef(ast.VarType));
+    uint64_t elementSize = (elementType->getPrimitiveSizeInBits() + 7) / 8;
+
+    if (ast.ArraySize->Kind == ExprKind::Number) {
+        auto& size = static_cast<NumberExpr&>(*ast.ArraySize);
+        if (size.Type == TokenType::INT_LITERAL && size.IntValue >= 0 &&
+            uint64_t(size.IntValue) * elementSize <= StackArrayLimit) {
+            auto* arrayType = llvm::ArrayType::get(elementType, size.IntValue);
+            llvm::AllocaInst* alloca = entry.CreateAlloca(arrayType, nullptr, name);
+            // Declarations kept from dead code are empty, and may follow a
+            // return.
+            if (size.IntValue > 0 && !builder->GetInsertBlock()->getTerminator()) {
+                builder->CreateMemSet(alloca, builder->getInt8(0), size.IntValue * elementSize, alloca->getAlign());
+            }
+            namedValues[ast.VarName.Id] = alloca;
+            return;
+        }
+    }
+
+    llvm::Value* count = visit(*ast.ArraySize);
+    if (!count) {
+        return;
+    }
+    if (!count->getType()->isIntegerTy(32)) {
+        logErrorV("Array size must be an int");
+        return;
+    }
+
+    llvm::PointerType* pointerType = elementType->getPointerTo();
+    llvm::AllocaInst* slot = entry.CreateAlloca(pointerType, nullptr, name);
+    entry.CreateStore(llvm::ConstantPointerNull::get(pointerType), slot);
+    heapArrays.push_back(slot);
+
+    llvm::Value* previous = builder->CreateLoad(pointerType, slot);
+    builder->CreateCall(getFunction("free"), builder->CreatePointerCast(previous, builder->getInt8PtrTy()));
+    llvm::Value* memory = builder->CreateCall(getFunction("calloc"), {builder->CreateSExt(count, builder->getInt64Ty()), builder->getInt64(elementSize)});
+    builder->CreateStore(builder->CreatePointerCast(memory, pointerType), slot);
+    namedValues[ast.VarName.Id] = slot;
+}
+
+void CodeGen::freeHeapArrays(llvm::Function* function) {
+    for (auto& BB : *function) {
+        // Blocks are left open when a statement fails to generate.
+        if (auto* ret = llvm::dyn_cast_or_null<llvm::ReturnInst>(BB.getTerminator())) {
+            builder->SetInsertPoint(ret);
+            for (llvm::AllocaInst* slot : heapArrays) {
+                llvm::Value* memory = builder->CreateLoad(slot->getAllocatedType(), slot);
+                builder->CreateCall(getFunction("free"), builder->CreatePointerCast(memory, builder->getInt8PtrTy()));
+            }
+        }
+    }
+    heapArrays.clear();
+}
+
+void CodeGen::visit(AssignStmt& ast) {
+    llvm::Value* value = visit(*ast.Value);
+    if (!value) {
+        return;
+    }
+
+    llvm::Type* targetType;
+    llvm::Value* target;
+    llvm::AllocaInst* vectorSlot = nullptr;
+    if (ast.Target->Kind == ExprKind::Index) {
+        auto& index = static_cast<IndexExpr&>(*ast.Target);
+        vectorSlot = namedValues.lookup(index.Array->Name.Id);
+        if (!vectorSlot || !vectorSlot->getAllocatedType()->isVectorTy()) {
+            vectorSlot = nullptr;
+        }
+    }
+    if (vectorSlot) {
+        // Lanes are replaced in the loaded vector, which is stored back.
+        auto& index = static_cast<IndexExpr&>(*ast.Target);
+        auto* vectorType = llvm::cast<llvm::FixedVectorType>(vectorSlot->getAllocatedType());
+        llvm::Value* lane = laneIndex(*index.Index, vectorType);
+        if (!lane) {
+            return;
+        }
+        if (value->getType() != vectorType->getElementType()) {
+            logErrorV("Assigned value has the wrong type");
+            return;
+        }
+        llvm::Value* vector = builder->CreateLoad(vectorType, vectorSlot, llvm::StringRef(index.Array->Name.Text));
+        builder->CreateStore(builder->CreateInsertElement(vector, value, lane, "vecins"), vectorSlot);
+        return;
+    } else if (ast.Target->Kind == ExprKind::Index) {
+        target = elementPointer(static_cast<IndexExpr&>(*ast.Target), targetType);
+        if (!target) {
+            return;
+        }
+    } else {
+        uint32_t id = static_cast<VariableExpr&>(*ast.Target).Name.Id;
+        llvm::AllocaInst* a = namedValues.lookup(id);
+        if (!a) {
+            logErrorV("Unknown variable name");
+            return;
+        }
+        targetType = a->getAllocatedType();
+        // Heap arrays and strings both live in pointer slots, so arrays are
+        // told apart by their declared type.
+        if (!arrayElementType(namedTypes.lookup(id)).empty()) {
+            logErrorV("Arrays can't be assigned");
+            return;
+        }
+        target = a;
+    }
+
+    if (value->getType() != targetType) {
+        logErrorV("Assigned value has the wrong type");
+        return;
+    }
+    builder->CreateStore(value, target);
+}
+
+// Branch conditions are true when non-zero, as in C: ints and floats are
+// compared against zero, bools are used as they are.
+llvm::Value* CodeGen::condition(Expr& expr, const char* name) {
+    llvm::Value* value = visit(expr);
+    if (!value) {
+        return nullptr;
+    }
+    llvm::Type* type = value->getType();
+    if (type->isIntegerTy()) {
+        return builder->CreateICmpNE(value, llvm::ConstantInt::get(type, 0), name);
+    }
+    if (type->isFloatTy()) {
+        return builder->CreateFCmpUNE(value, llvm::ConstantFP::get(type, 0.0), name);
+    }
+    return logErrorV("Condition must be a bool, int or float");
 }
 
 void CodeGen::visit(IfStmt& ast) {
-    llvm::Value* condV = visit(*ast.Condition);
+    llvm::Value* condV = condition(*ast.Condition, "ifcond");
     if (!condV) return;
 
-    condV = builder->CreateICmpNE(condV, llvm::ConstantInt::get(builder->getInt1Ty(), 0, true), "ifcond");
-
     llvm::Function* theFunction = builder->GetInsertBlock()->getParent();
     llvm::BasicBlock* thenBB = llvm::BasicBlock::Create(*context, "then", theFunction);
     llvm::BasicBlock* elseBB = llvm::BasicBlock::Create(*context, "else", theFunction);
@@ -272,13 +1174,17 @@ void CodeGen::visit(IfStmt& ast) {
 
     builder->SetInsertPoint(thenBB);
     visit(*ast.ThenBranch);
-    builder->CreateBr(mergeBB);
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(mergeBB);
+    }
 
     builder->SetInsertPoint(elseBB);
     if (ast.ElseBranch) {
         visit(*ast.ElseBranch);
     }
-    builder->CreateBr(mergeBB);
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(mergeBB);
+    }
 
     builder->SetInsertPoint(mergeBB);
 }
@@ -286,18 +1192,58 @@ void CodeGen::visit(IfStmt& ast) {
 void CodeGen::visit(WhileStmt& ast) {
     llvm::Function* theFunction = builder->GetInsertBlock()->getParent();
     llvm::BasicBlock* loopBB = llvm::BasicBlock::Create(*context, "loop", theFunction);
-    llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(*context, "afterloop");
+    llvm::BasicBlock* bodyBB = llvm::BasicBlock::Create(*context, "loopbody", theFunction);
+    llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(*context, "afterloop", theFunction);
 
     builder->CreateBr(loopBB);
     builder->SetInsertPoint(loopBB);
 
-    llvm::Value* condV = visit(*ast.Condition);
-    condV = builder->CreateICmpNE(condV, llvm::ConstantInt::get(builder->getInt1Ty(), 0, true), "loopcond");
+    llvm::Value* condV = condition(*ast.Condition, "loopcond");
+    if (!condV) return;
 
-    builder->CreateCondBr(condV, loopBB, afterBB);
+    builder->CreateCondBr(condV, bodyBB, afterBB);
 
+    builder->SetInsertPoint(bodyBB);
     visit(*ast.Body);
-    builder->CreateBr(loopBB);
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(loopBB);
+    }
+
+    builder->SetInsertPoint(afterBB);
+}
+
+void CodeGen::visit(ForStmt& ast) {
+    if (ast.Init) {
+        visit(*ast.Init);
+    }
+
+    llvm::Function* theFunction = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* condBB = llvm::BasicBlock::Create(*context, "forcond", theFunction);
+    llvm::BasicBlock* bodyBB = llvm::BasicBlock::Create(*context, "forbody", theFunction);
+    llvm::BasicBlock* stepBB = llvm::BasicBlock::Create(*context, "forstep", theFunction);
+    llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(*context, "afterfor", theFunction);
+
+    builder->CreateBr(condBB);
+    builder->SetInsertPoint(condBB);
+    if (ast.Condition) {
+        llvm::Value* condV = condition(*ast.Condition, "forcond");
+        if (!condV) return;
+        builder->CreateCondBr(condV, bodyBB, afterBB);
+    } else {
+        builder->CreateBr(bodyBB);
+    }
+
+    builder->SetInsertPoint(bodyBB);
+    visit(*ast.Body);
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(stepBB);
+    }
+
+    builder->SetInsertPoint(stepBB);
+    if (ast.Step) {
+        visit(*ast.Step);
+    }
+    builder->CreateBr(condBB);
 
     builder->SetInsertPoint(afterBB);
 }
@@ -306,7 +1252,7 @@ llvm::Function* CodeGen::visit(PrototypeAST& ast) {
     std::vector<llvm::Type*> argTypes;
     llvm::Type* returnType = getType(ast.ReturnType);
 
-    if (ast.Name == "main") {
+    if (ast.Name.Text == "main") {
         // Force main to have the standard C signature
         argTypes.push_back(builder->getInt32Ty()); // argc
         argTypes.push_back(llvm::PointerType::get(builder->getInt8Ty()->getPointerTo(), 0)); // argv
@@ -317,15 +1263,24 @@ llvm::Function* CodeGen::visit(PrototypeAST& ast) {
     }
 
     llvm::FunctionType* ft = llvm::FunctionType::get(returnType, argTypes, false);
-    llvm::Function* f = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, ast.Name, module.get());
+    llvm::Function* f = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, llvm::StringRef(ast.Name.Text), module.get());
+    if (linkage && linkage->isInternal(f->getName())) {
+        f->setCallingConv(llvm::CallingConv::Fast);
+    }
+    // The optimizer's cost model and every backend, ThinLTO's included,
+    // take the subtarget from these.
+    f->addFnAttr("target-cpu", target.cpu);
+    if (!target.features.empty()) {
+        f->addFnAttr("target-features", target.features);
+    }
 
-    if (ast.Name == "main") {
+    if (ast.Name.Text == "main") {
         f->getArg(0)->setName("argc");
         f->getArg(1)->setName("argv");
     } else {
         unsigned idx = 0;
         for (auto& arg : f->args()) {
-            arg.setName(ast.Args[idx++].second);
+            arg.setName(llvm::StringRef(ast.Args[idx++].second.Text));
         }
     }
 
@@ -333,7 +1288,10 @@ llvm::Function* CodeGen::visit(PrototypeAST& ast) {
 }
 
 llvm::Function* CodeGen::visit(FunctionAST& ast) {
-    llvm::Function* theFunction = getFunction(ast.Proto->Name);
+    if (!emits(*ast.Proto)) {
+        return nullptr;
+    }
+    llvm::Function* theFunction = getFunction(ast.Proto->Name.Text);
     if (!theFunction) {
         theFunction = visit(*ast.Proto);
     }
@@ -346,17 +1304,28 @@ llvm::Function* CodeGen::visit(FunctionAST& ast) {
     builder->SetInsertPoint(BB);
 
     namedValues.clear();
+    namedTypes.clear();
+    heapArrays.clear();
     for (auto& arg : theFunction->args()) {
         llvm::AllocaInst* alloca = builder->CreateAlloca(arg.getType(), 0, arg.getName());
         builder->CreateStore(&arg, alloca);
-        namedValues[std::string(arg.getName())] = alloca;
+        // main's forced argc/argv have no symbol in the source
+        if (arg.getArgNo() < ast.Proto->Args.size()) {
+            namedValues[ast.Proto->Args[arg.getArgNo()].second.Id] = alloca;
+            namedTypes[ast.Proto->Args[arg.getArgNo()].second.Id] = ast.Proto->Args[arg.getArgNo()].first;
+        }
     }
 
     visit(*ast.Body);
 
-    if (theFunction->getReturnType()->isVoidTy()) {
-        builder->CreateRetVoid();
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        if (theFunction->getReturnType()->isVoidTy()) {
+            builder->CreateRetVoid();
+        } else {
+            builder->CreateUnreachable();
+        }
     }
+    freeHeapArrays(theFunction);
 
     llvm::verifyFunction(*theFunction);
     return theFunction;
@@ -364,11 +1333,9 @@ llvm::Function* CodeGen::visit(FunctionAST& ast) {
 
 void CodeGen::visit(ModuleAST& ast) {
     // First pass: create function declarations.
-    for (auto& func : ast.Functions) {
-        visit(*func->Proto);
-    }
+    declarePrototypes(ast);
     // Second pass: generate function bodies.
-    for (auto& func : ast.Functions) {
+    for (auto* func : ast.Functions) {
         visit(*func);
     }
 }
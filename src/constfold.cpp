@@ -0,0 +1,349 @@
+#include "constfold.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+static bool isInt(Expr* expr) {
+    return expr->Kind == ExprKind::Number && static_cast<NumberExpr*>(expr)->Type == TokenType::INT_LITERAL;
+}
+
+static bool isFloat(Expr* expr) {
+    return expr->Kind == ExprKind::Number && static_cast<NumberExpr*>(expr)->Type == TokenType::FLOAT_LITERAL;
+}
+
+static bool isBool(Expr* expr) {
+    return expr->Kind == ExprKind::Bool;
+}
+
+// Calls are the only expressions with side effects, and && / || evaluate
+// both operands, so only call-free operands may be dropped.
+static bool hasCalls(Expr* expr) {
+    switch (expr->Kind) {
+        case ExprKind::Call: return true;
+        case ExprKind::Binary: {
+            auto* binary = static_cast<BinaryExpr*>(expr);
+            return hasCalls(binary->LHS) || hasCalls(binary->RHS);
+        }
+        case ExprKind::Unary: return hasCalls(static_cast<UnaryExpr*>(expr)->RHS);
+        case ExprKind::Index: return hasCalls(static_cast<IndexExpr*>(expr)->Index);
+        case ExprKind::Vector: {
+            auto& lanes = static_cast<VectorExpr*>(expr)->Lanes;
+            return std::any_of(lanes.begin(), lanes.end(), hasCalls);
+        }
+        default: return false;
+    }
+}
+
+void ConstantFolder::run(ModuleAST& ast) {
+    arena = &ast.Nodes;
+    for (auto* func : ast.Functions) {
+        visit(*func->Body);
+    }
+    arena = nullptr;
+}
+
+Expr* ConstantFolder::fold(Expr*& expr) {
+    if (expr) {
+        expr = visit(*expr);
+    }
+    return expr;
+}
+
+Expr* ConstantFolder::makeBool(bool value) {
+    ++folded;
+    return arena->make<BoolExpr>(value);
+}
+
+Expr* ConstantFolder::visit(BinaryExpr& ast) {
+    Expr* L = fold(ast.LHS);
+    Expr* R = fold(ast.RHS);
+
+    if (isInt(L) && isInt(R)) {
+        int32_t l = static_cast<NumberExpr*>(L)->IntValue;
+        int32_t r = static_cast<NumberExpr*>(R)->IntValue;
+        // Unsigned arithmetic wraps like the i32 add/sub/mul it replaces.
+        uint32_t ul = l, ur = r;
+        int32_t value;
+        switch (ast.Op) {
+            case BinaryOp::Add: value = static_cast<int32_t>(ul + ur); break;
+            case BinaryOp::Sub: value = static_cast<int32_t>(ul - ur); break;
+            case BinaryOp::Mul: value = static_cast<int32_t>(ul * ur); break;
+            case BinaryOp::Div:
+                // Left alone when sdiv would be undefined.
+                if (r == 0 || (l == std::numeric_limits<int32_t>::min() && r == -1)) return &ast;
+                value = l / r;
+                break;
+            case BinaryOp::And: value = l & r; break;
+            case BinaryOp::Or: value = l | r; break;
+            case BinaryOp::Less: return makeBool(l < r);
+            case BinaryOp::Greater: return makeBool(l > r);
+            case BinaryOp::LessEqual: return makeBool(l <= r);
+            case BinaryOp::GreaterEqual: return makeBool(l >= r);
+            case BinaryOp::Equal: return makeBool(l == r);
+            case BinaryOp::NotEqual: return makeBool(l != r);
+            default: return &ast;
+        }
+        ++folded;
+        return arena->make<NumberExpr>(value);
+    }
+
+    if (isFloat(L) && isFloat(R)) {
+        float l = static_cast<NumberExpr*>(L)->FloatValue;
+        float r = static_cast<NumberExpr*>(R)->FloatValue;
+        // CodeGen compares floats with unordered predicates: true on NaN.
+        bool unordered = std::isnan(l) || std::isnan(r);
+        float value;
+        switch (ast.Op) {
+            case BinaryOp::Add: value = l + r; break;
+            case BinaryOp::Sub: value = l - r; break;
+            case BinaryOp::Mul: value = l * r; break;
+            case BinaryOp::Div: value = l / r; break;
+            case BinaryOp::Less: return makeBool(unordered || l < r);
+            case BinaryOp::Greater: return makeBool(unordered || l > r);
+            case BinaryOp::LessEqual: return makeBool(unordered || l <= r);
+            case BinaryOp::GreaterEqual: return makeBool(unordered || l >= r);
+            case BinaryOp::Equal: return makeBool(unordered || l == r);
+            case BinaryOp::NotEqual: return makeBool(unordered || l != r);
+            default: return &ast;
+        }
+        ++folded;
+        return arena->make<NumberExpr>(value);
+    }
+
+    if (isBool(L) && isBool(R)) {
+        bool l = static_cast<BoolExpr*>(L)->Value;
+        bool r = static_cast<BoolExpr*>(R)->Value;
+        switch (ast.Op) {
+            case BinaryOp::And: return makeBool(l && r);
+            case BinaryOp::Or: return makeBool(l || r);
+            case BinaryOp::Equal: return makeBool(l == r);
+            case BinaryOp::NotEqual: return makeBool(l != r);
+            default: return &ast;
+        }
+    }
+
+    // One constant operand of && or || either decides the result or drops
+    // out of it.
+    if ((ast.Op == BinaryOp::And || ast.Op == BinaryOp::Or) && (isBool(L) || isBool(R))) {
+        bool constant = static_cast<BoolExpr*>(isBool(L) ? L : R)->Value;
+        Expr* other = isBool(L) ? R : L;
+        bool identity = ast.Op == BinaryOp::And ? constant : !constant;
+        if (identity) {
+            ++folded;
+            return other;
+        }
+        if (!hasCalls(other)) {
+            return makeBool(constant);
+        }
+    }
+    return &ast;
+}
+
+Expr* ConstantFolder::visit(UnaryExpr& ast) {
+    Expr* operand = fold(ast.RHS);
+    if (ast.Op == UnaryOp::Not && isBool(operand)) {
+        return makeBool(!static_cast<BoolExpr*>(operand)->Value);
+    }
+    if (isInt(operand)) {
+        uint32_t value = static_cast<NumberExpr*>(operand)->IntValue;
+        ++folded;
+        return arena->make<NumberExpr>(static_cast<int32_t>(ast.Op == UnaryOp::Neg ? 0u - value : ~value));
+    }
+    if (ast.Op == UnaryOp::Neg && isFloat(operand)) {
+        ++folded;
+        return arena->make<NumberExpr>(-static_cast<NumberExpr*>(operand)->FloatValue);
+    }
+    return &ast;
+}
+
+Expr* ConstantFolder::visit(CallExpr& ast) {
+    for (auto*& arg : ast.Args) {
+        fold(arg);
+    }
+    return &ast;
+}
+
+Expr* ConstantFolder::visit(VectorExpr& ast) {
+    for (auto*& lane : ast.Lanes) {
+        fold(lane);
+    }
+    return &ast;
+}
+
+Expr* ConstantFolder::visit(IndexExpr& ast) {
+    fold(ast.Index);
+    return &ast;
+}
+
+void ConstantFolder::visit(BlockStmt& ast) {
+    size_t start = stmtScratch.size();
+    size_t count = ast.Statements.size();
+    bool changed = false;
+    for (size_t i = 0; i < count; ++i) {
+        Stmt* stmt = ast.Statements[i];
+        visit(*stmt);
+        changed |= !appendLive(stmt);
+
+        // Nothing after a return runs, but later code may still name the
+        // variables declared there. They are kept ahead of the return, so
+        // the block still ends in its terminator.
+        if (stmtScratch.size() > start && stmtScratch.back()->Kind == StmtKind::Return) {
+            Stmt* terminator = stmtScratch.back();
+            stmtScratch.pop_back();
+            for (size_t j = i + 1; j < count; ++j) {
+                appendDeclarations(ast.Statements[j]);
+            }
+            stmtScratch.push_back(terminator);
+            removed += count - i - 1;
+            changed |= i + 1 < count;
+            break;
+        }
+    }
+
+    if (changed) {
+        size_t live = stmtScratch.size() - start;
+        if (live <= count) {
+            std::copy(stmtScratch.begin() + start, stmtScratch.end(), ast.Statements.begin());
+            ast.Statements = ast.Statements.first(live);
+        } else {
+            ast.Statements = arena->copyArray(std::span<Stmt* const>(stmtScratch.data() + start, live));
+        }
+    }
+    stmtScratch.resize(start);
+}
+
+// Appends stmt, or what is left of it once a constant condition has picked
+// a branch, to the block being rebuilt. Returns false if stmt was replaced.
+bool ConstantFolder::appendLive(Stmt* stmt) {
+    if (stmt->Kind == StmtKind::If) {
+        auto* ifStmt = static_cast<IfStmt*>(stmt);
+        if (isBool(ifStmt->Condition)) {
+            bool taken = static_cast<BoolExpr*>(ifStmt->Condition)->Value;
+            BlockStmt* live = taken ? ifStmt->ThenBranch : ifStmt->ElseBranch;
+            BlockStmt* dead = taken ? ifStmt->ElseBranch : ifStmt->ThenBranch;
+            // Blocks don't open a scope, so the live branch can be inlined.
+            if (live) {
+                stmtScratch.insert(stmtScratch.end(), live->Statements.begin(), live->Statements.end());
+            }
+            if (dead) {
+                appendDeclarations(dead);
+            }
+            ++removed;
+            return false;
+        }
+    } else if (stmt->Kind == StmtKind::While) {
+        auto* whileStmt = static_cast<WhileStmt*>(stmt);
+        if (isBool(whileStmt->Condition) && !static_cast<BoolExpr*>(whileStmt->Condition)->Value) {
+            appendDeclarations(whileStmt->Body);
+            ++removed;
+            return false;
+        }
+    } else if (stmt->Kind == StmtKind::For) {
+        // The initializer runs even if the loop body never does.
+        auto* forStmt = static_cast<ForStmt*>(stmt);
+        if (forStmt->Condition && isBool(forStmt->Condition) && !static_cast<BoolExpr*>(forStmt->Condition)->Value) {
+            if (forStmt->Init) {
+                stmtScratch.push_back(forStmt->Init);
+            }
+            appendDeclarations(forStmt->Body);
+            ++removed;
+            return false;
+        }
+    }
+    stmtScratch.push_back(stmt);
+    return true;
+}
+
+// Keeps the variables of a removed statement declared, without their
+// initializers, which never ran.
+void ConstantFolder::appendDeclarations(Stmt* stmt) {
+    switch (stmt->Kind) {
+        case StmtKind::VarDecl: {
+            auto* decl = static_cast<VarDeclStmt*>(stmt);
+            decl->Init = nullptr;
+            if (decl->ArraySize) {
+                // The element count may call functions; an empty array
+                // keeps the name without evaluating it.
+                decl->ArraySize = arena->make<NumberExpr>(0);
+            }
+            stmtScratch.push_back(decl);
+            break;
+        }
+        case StmtKind::Block:
+            for (auto* inner : static_cast<BlockStmt*>(stmt)->Statements) {
+                appendDeclarations(inner);
+            }
+            break;
+        case StmtKind::If: {
+            auto* ifStmt = static_cast<IfStmt*>(stmt);
+            appendDeclarations(ifStmt->ThenBranch);
+            if (ifStmt->ElseBranch) {
+                appendDeclarations(ifStmt->ElseBranch);
+            }
+            break;
+        }
+        case StmtKind::While:
+            appendDeclarations(static_cast<WhileStmt*>(stmt)->Body);
+            break;
+        case StmtKind::For: {
+            auto* forStmt = static_cast<ForStmt*>(stmt);
+            if (forStmt->Init) {
+                appendDeclarations(forStmt->Init);
+            }
+            appendDeclarations(forStmt->Body);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void ConstantFolder::visit(ReturnStmt& ast) {
+    fold(ast.Value);
+}
+
+void ConstantFolder::visit(PrintStmt& ast) {
+    fold(ast.Format);
+    for (auto*& arg : ast.Args) {
+        fold(arg);
+    }
+}
+
+void ConstantFolder::visit(ExprStmt& ast) {
+    fold(ast.Expression);
+}
+
+void ConstantFolder::visit(VarDeclStmt& ast) {
+    fold(ast.Init);
+    fold(ast.ArraySize);
+}
+
+void ConstantFolder::visit(IfStmt& ast) {
+    fold(ast.Condition);
+    visit(*ast.ThenBranch);
+    if (ast.ElseBranch) {
+        visit(*ast.ElseBranch);
+    }
+}
+
+void ConstantFolder::visit(WhileStmt& ast) {
+    fold(ast.Condition);
+    visit(*ast.Body);
+}
+
+void ConstantFolder::visit(AssignStmt& ast) {
+    fold(ast.Target);
+    fold(ast.Value);
+}
+
+void ConstantFolder::visit(ForStmt& ast) {
+    if (ast.Init) {
+        visit(*ast.Init);
+    }
+    fold(ast.Condition);
+    visit(*ast.Body);
+    if (ast.Step) {
+        visit(*ast.Step);
+    }
+}
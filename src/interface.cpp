@@ -0,0 +1,162 @@
+#include "interface.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <iterator>
+
+static const char Magic[4] = {'C', 'A', 'T', 'I'};
+static const uint32_t Version = 3;
+static const size_t HeaderSize = 16;
+static const size_t ProtoRecordSize = 16;
+static const size_t ArgRecordSize = 12;
+
+static const char* const TypeNames[] = {"void", "int", "float", "bool", "string", "int[]", "float[]", "bool[]",
+                                          "int4", "int8", "float4", "float8", "bool4", "bool8"};
+
+// Returns -1 for types without a code. Those can't be written as void:
+// importers hash the prototypes they read into their cache keys, so two
+// different types must never decode the same.
+static int encodeType(std::string_view type) {
+    for (uint8_t i = 0; i < std::size(TypeNames); ++i) {
+        if (type == TypeNames[i]) return i;
+    }
+    return -1;
+}
+
+bool ModuleInterface::write(const ModuleAST& ast, const std::string& filename) {
+    std::string strings;
+    auto addString = [&strings](std::string_view s) {
+        uint32_t off = strings.size();
+        strings += s;
+        return off;
+    };
+
+    for (auto* func : ast.Functions) {
+        const PrototypeAST& proto = *func->Proto;
+        std::string_view unknown = encodeType(proto.ReturnType) < 0 ? proto.ReturnType : "";
+        for (auto& arg : proto.Args) {
+            if (unknown.empty() && encodeType(arg.first) < 0) {
+                unknown = arg.first;
+            }
+        }
+        if (!unknown.empty()) {
+            llvm::errs() << "Cannot write type '" << unknown << "' of " << proto.Name.Text << " to an interface\n";
+            return false;
+        }
+    }
+
+    std::error_code EC;
+    llvm::raw_fd_ostream out(filename, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        llvm::errs() << "Could not open file: " << EC.message();
+        return false;
+    }
+
+    uint32_t argCount = 0;
+    for (auto* func : ast.Functions) {
+        argCount += func->Proto->Args.size();
+    }
+
+    llvm::support::endian::Writer w(out, llvm::support::little);
+    out.write(Magic, sizeof(Magic));
+    w.write<uint32_t>(Version);
+    w.write<uint32_t>(ast.Functions.size());
+    w.write<uint32_t>(argCount);
+
+    uint32_t firstArg = 0;
+    for (auto* func : ast.Functions) {
+        const PrototypeAST& proto = *func->Proto;
+        w.write<uint32_t>(addString(proto.Name.Text));
+        w.write<uint32_t>(proto.Name.Text.size());
+        w.write<uint8_t>(encodeType(proto.ReturnType));
+        w.write<uint8_t>(0);
+        w.write<uint16_t>(proto.Args.size());
+        w.write<uint32_t>(firstArg);
+        firstArg += proto.Args.size();
+    }
+
+    for (auto* func : ast.Functions) {
+        for (auto& arg : func->Proto->Args) {
+            w.write<uint8_t>(encodeType(arg.first));
+            w.write<uint8_t>(0);
+            w.write<uint16_t>(0);
+            w.write<uint32_t>(addString(arg.second.Text));
+            w.write<uint32_t>(arg.second.Text.size());
+        }
+    }
+
+    out << strings;
+    return true;
+}
+
+bool ModuleInterface::read(const std::string& filename, Arena& arena, SymbolTable& symbols, std::vector<PrototypeAST*>& protos) {
+    auto bufOrErr = llvm::MemoryBuffer::getFile(filename, false, false);
+    if (!bufOrErr) {
+        llvm::errs() << "Could not open interface " << filename << ": " << bufOrErr.getError().message() << "\n";
+        return false;
+    }
+
+    const char* data = (*bufOrErr)->getBufferStart();
+    size_t size = (*bufOrErr)->getBufferSize();
+    auto u16 = [data](size_t off) { return llvm::support::endian::read16le(data + off); };
+    auto u32 = [data](size_t off) { return llvm::support::endian::read32le(data + off); };
+
+    if (size < HeaderSize || memcmp(data, Magic, sizeof(Magic)) != 0 || u32(4) != Version) {
+        llvm::errs() << "Not a valid interface file: " << filename << "\n";
+        return false;
+    }
+
+    uint32_t protoCount = u32(8);
+    uint32_t argCount = u32(12);
+    size_t argsStart = HeaderSize + size_t(protoCount) * ProtoRecordSize;
+    size_t stringsStart = argsStart + size_t(argCount) * ArgRecordSize;
+    if (stringsStart > size) {
+        llvm::errs() << "Truncated interface file: " << filename << "\n";
+        return false;
+    }
+
+    auto getSymbol = [&](uint32_t off, uint32_t len, Symbol& s) {
+        if (stringsStart + off + len > size) return false;
+        s = symbols.get(std::string_view(data + stringsStart + off, len));
+        return true;
+    };
+    auto getType = [](uint8_t code, std::string_view& type) {
+        if (code >= std::size(TypeNames)) return false;
+        type = TypeNames[code];
+        return true;
+    };
+
+    for (uint32_t i = 0; i < protoCount; ++i) {
+        size_t rec = HeaderSize + size_t(i) * ProtoRecordSize;
+        Symbol name;
+        std::string_view returnType;
+        if (!getSymbol(u32(rec), u32(rec + 4), name) || !getType(data[rec + 8], returnType)) {
+            llvm::errs() << "Corrupt interface file: " << filename << "\n";
+            return false;
+        }
+        uint16_t nargs = u16(rec + 10);
+        uint32_t firstArg = u32(rec + 12);
+        if (size_t(firstArg) + nargs > argCount) {
+            llvm::errs() << "Corrupt interface file: " << filename << "\n";
+            return false;
+        }
+
+        std::vector<std::pair<std::string_view, Symbol>> args;
+        for (uint32_t a = firstArg; a < firstArg + nargs; ++a) {
+            size_t argRec = argsStart + size_t(a) * ArgRecordSize;
+            Symbol argName;
+            std::string_view argType;
+            if (!getSymbol(u32(argRec + 4), u32(argRec + 8), argName) || !getType(data[argRec], argType)) {
+                llvm::errs() << "Corrupt interface file: " << filename << "\n";
+                return false;
+            }
+            args.push_back({argType, argName});
+        }
+
+        auto argSpan = arena.copyArray(std::span<const std::pair<std::string_view, Symbol>>(args));
+        protos.push_back(arena.make<PrototypeAST>(name, argSpan, returnType));
+    }
+    return true;
+}
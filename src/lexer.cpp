@@ -1,16 +1,34 @@
 #include "lexer.h"
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <cstring>
 
-static const std::unordered_map<std::string, TokenType> keywords = {
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+static constexpr Keyword keywordList[] = {
     {"fn", TokenType::FN},
     {"return", TokenType::RETURN},
     {"if", TokenType::IF},
     {"else", TokenType::ELSE},
     {"while", TokenType::WHILE},
+    {"for", TokenType::FOR},
     {"int", TokenType::INT_TYPE},
     {"float", TokenType::FLOAT_TYPE},
     {"string", TokenType::STRING_TYPE},
     {"bool", TokenType::BOOL_TYPE},
+    {"int4", TokenType::VECTOR_TYPE},
+    {"int8", TokenType::VECTOR_TYPE},
+    {"float4", TokenType::VECTOR_TYPE},
+    {"float8", TokenType::VECTOR_TYPE},
+    {"bool4", TokenType::VECTOR_TYPE},
+    {"bool8", TokenType::VECTOR_TYPE},
     {"true", TokenType::BOOL_LITERAL},
     {"false", TokenType::BOOL_LITERAL},
     {"print", TokenType::PRINT},
@@ -18,83 +36,236 @@ static const std::unordered_map<std::string, TokenType> keywords = {
     {"meow", TokenType::MEOW},
 };
 
-Lexer::Lexer(const std::string& source) : source(source) {}
+// Perfect hash over the keyword set: the first and last characters and the
+// length are enough to tell every keyword apart. Adding a keyword that collides fails
+// the static_assert below; pick new multipliers if that happens.
+static constexpr size_t KeywordTableSize = 64;
+
+static constexpr size_t keywordHash(std::string_view text) {
+    return (size_t(text.front()) + 3 * size_t(text.back()) + 4 * text.size()) % KeywordTableSize;
+}
+
+static constexpr auto keywordTable = [] {
+    std::array<Keyword, KeywordTableSize> table{};
+    for (const Keyword& kw : keywordList) {
+        table[keywordHash(kw.text)] = kw;
+    }
+    return table;
+}();
+
+static constexpr bool keywordHashIsPerfect() {
+    for (const Keyword& kw : keywordList) {
+        if (keywordTable[keywordHash(kw.text)].text != kw.text) return false;
+    }
+    return true;
+}
+static_assert(keywordHashIsPerfect(), "keyword hash has collisions");
+
+static const Keyword* findKeyword(std::string_view text) {
+    const Keyword& kw = keywordTable[keywordHash(text)];
+    return kw.text == text ? &kw : nullptr;
+}
+
+// Character classes for the vectorized scanners. Each class provides a
+// scalar test and SSE2/AVX2 versions that produce a byte mask (0xFF where
+// the byte is in the class). Bytes >= 0x80 are negative as signed chars and
+// so never fall in any of the ASCII ranges.
+#if defined(__SSE2__)
+static inline __m128i inRange(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v));
+}
+static inline __m128i isByte(__m128i v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+#endif
+#if defined(__AVX2__)
+static inline __m256i inRange(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+static inline __m256i isByte(__m256i v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+#endif
+
+struct IdentifierClass {
+    static bool scalar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+#if defined(__SSE2__)
+    static __m128i vector(__m128i v) {
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        return _mm_or_si128(_mm_or_si128(inRange(lower, 'a', 'z'), inRange(v, '0', '9')), isByte(v, '_'));
+    }
+#endif
+#if defined(__AVX2__)
+    static __m256i vector(__m256i v) {
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        return _mm256_or_si256(_mm256_or_si256(inRange(lower, 'a', 'z'), inRange(v, '0', '9')), isByte(v, '_'));
+    }
+#endif
+};
+
+struct DigitClass {
+    static bool scalar(char c) { return c >= '0' && c <= '9'; }
+#if defined(__SSE2__)
+    static __m128i vector(__m128i v) { return inRange(v, '0', '9'); }
+#endif
+#if defined(__AVX2__)
+    static __m256i vector(__m256i v) { return inRange(v, '0', '9'); }
+#endif
+};
+
+struct WhitespaceClass {
+    static bool scalar(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+#if defined(__SSE2__)
+    static __m128i vector(__m128i v) {
+        return _mm_or_si128(_mm_or_si128(isByte(v, ' '), isByte(v, '\t')), _mm_or_si128(isByte(v, '\r'), isByte(v, '\n')));
+    }
+#endif
+#if defined(__AVX2__)
+    static __m256i vector(__m256i v) {
+        return _mm256_or_si256(_mm256_or_si256(isByte(v, ' '), isByte(v, '\t')),
+                               _mm256_or_si256(isByte(v, '\r'), isByte(v, '\n')));
+    }
+#endif
+};
+
+// Plain string literal content: anything but the closing quote, an escape or
+// a newline (which needs line bookkeeping).
+struct StringBodyClass {
+    static bool scalar(char c) { return c != '"' && c != '\\' && c != '\n'; }
+#if defined(__SSE2__)
+    static __m128i vector(__m128i v) {
+        __m128i stop = _mm_or_si128(_mm_or_si128(isByte(v, '"'), isByte(v, '\\')), isByte(v, '\n'));
+        return _mm_andnot_si128(stop, _mm_set1_epi8(-1));
+    }
+#endif
+#if defined(__AVX2__)
+    static __m256i vector(__m256i v) {
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(isByte(v, '"'), isByte(v, '\\')), isByte(v, '\n'));
+        return _mm256_andnot_si256(stop, _mm256_set1_epi8(-1));
+    }
+#endif
+};
+
+// Length of the run of bytes in Class starting at p, 32 or 16 bytes at a
+// time while that much input remains, then byte by byte.
+template <typename Class>
+static size_t runLength(const char* p, const char* end) {
+    const char* begin = p;
+#if defined(__AVX2__)
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t outside = ~uint32_t(_mm256_movemask_epi8(Class::vector(v)));
+        if (outside) return p - begin + __builtin_ctz(outside);
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t outside = ~uint32_t(_mm_movemask_epi8(Class::vector(v))) & 0xFFFF;
+        if (outside) return p - begin + __builtin_ctz(outside);
+        p += 16;
+    }
+#endif
+    while (p < end && Class::scalar(*p)) ++p;
+    return p - begin;
+}
+
+Lexer::Lexer(std::string_view source, SymbolTable& symbols) : source(source), symbols(symbols) {}
+
+Token Lexer::next() {
+    ++tokensLexed;
+    skipWhitespace();
+    if (isAtEnd()) {
+        start = current;
+        startColumn = column;
+        return makeToken(TokenType::END_OF_FILE);
+    }
+    return nextToken();
+}
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
-    while (!isAtEnd()) {
-        skipWhitespace();
-        if (isAtEnd()) break;
-        tokens.push_back(nextToken());
-    }
-    tokens.push_back({TokenType::END_OF_FILE, "", line, column});
+    do {
+        tokens.push_back(next());
+    } while (tokens.back().type != TokenType::END_OF_FILE);
     return tokens;
 }
 
+Token Lexer::makeToken(TokenType type) {
+    return {type, start, current - start, 0, line, startColumn};
+}
+
 void Lexer::skipWhitespace() {
+    const char* data = source.data();
+    const char* end = data + source.size();
     while (!isAtEnd()) {
-        char c = peek();
-        switch (c) {
-            case ' ':
-            case '\r':
-            case '\t':
-                advance();
-                break;
-            case '\n':
-                line++;
-                column = 1;
-                advance();
-                break;
-            case '/':
-                if (peekNext() == '/') {
-                    // A comment goes until the end of the line.
-                    while (peek() != '\n' && !isAtEnd()) advance();
-                } else {
-                    return;
-                }
-                break;
-            default:
-                return;
+        const char* p = data + current;
+        size_t n = runLength<WhitespaceClass>(p, end);
+        if (n) {
+            // Bring line/column up to date for the whole run at once.
+            const char* runEnd = p + n;
+            uint32_t newlines = std::count(p, runEnd, '\n');
+            if (newlines) {
+                const char* lastNewline = runEnd - 1;
+                while (*lastNewline != '\n') --lastNewline;
+                line += newlines;
+                column = 1 + (runEnd - lastNewline - 1);
+            } else {
+                column += n;
+            }
+            current += n;
+            continue;
+        }
+
+        if (peek() == '/' && peekNext() == '/') {
+            // A comment goes until the end of the line.
+            const void* newline = std::memchr(p, '\n', end - p);
+            size_t len = newline ? static_cast<const char*>(newline) - p : end - p;
+            current += len;
+            column += len;
+            continue;
         }
+        return;
     }
 }
 
 Token Lexer::nextToken() {
     start = current;
+    startColumn = column;
     char c = advance();
 
     switch (c) {
-        case '(': return {TokenType::LPAREN, "(", line, column};
-        case ')': return {TokenType::RPAREN, ")", line, column};
-        case '{': return {TokenType::LBRACE, "{", line, column};
-        case '}': return {TokenType::RBRACE, "}", line, column};
-        case ';': return {TokenType::SEMICOLON, ";", line, column};
-        case ',': return {TokenType::COMMA, ",", line, column};
-        case '+': return {TokenType::PLUS, "+", line, column};
-        case ':': return {TokenType::COLON, ":", line, column};
+        case '(': return makeToken(TokenType::LPAREN);
+        case ')': return makeToken(TokenType::RPAREN);
+        case '{': return makeToken(TokenType::LBRACE);
+        case '}': return makeToken(TokenType::RBRACE);
+        case '[': return makeToken(TokenType::LBRACKET);
+        case ']': return makeToken(TokenType::RBRACKET);
+        case ';': return makeToken(TokenType::SEMICOLON);
+        case ',': return makeToken(TokenType::COMMA);
+        case '+': return makeToken(TokenType::PLUS);
+        case '*': return makeToken(TokenType::STAR);
+        case '/': return makeToken(TokenType::SLASH); // '//' comments are skipped before we get here
+        case ':': return makeToken(TokenType::COLON);
         case '=':
-            return match('=') ? Token{TokenType::EQUAL_EQUAL, "==", line, column} : Token{TokenType::ASSIGN, "=", line, column};
+            return makeToken(match('=') ? TokenType::EQUAL_EQUAL : TokenType::ASSIGN);
         case '!':
-            return match('=') ? Token{TokenType::BANG_EQUAL, "!=", line, column} : Token{TokenType::BANG, "!", line, column};
+            return makeToken(match('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
         case '<':
-            return match('=') ? Token{TokenType::LESS_EQUAL, "<=", line, column} : Token{TokenType::LESS, "<", line, column};
+            return makeToken(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS);
         case '>':
-            return match('=') ? Token{TokenType::GREATER_EQUAL, ">=", line, column} : Token{TokenType::GT, ">", line, column};
+            return makeToken(match('=') ? TokenType::GREATER_EQUAL : TokenType::GT);
         case '&':
             if (match('&')) {
-                return {TokenType::AMPERSAND_AMPERSAND, "&&", line, column};
+                return makeToken(TokenType::AMPERSAND_AMPERSAND);
             }
             break;
         case '|':
             if (match('|')) {
-                return {TokenType::PIPE_PIPE, "||", line, column};
+                return makeToken(TokenType::PIPE_PIPE);
             }
             break;
         case '-':
-            if (match('>')) {
-                return {TokenType::ARROW, "->", line, column};
-            }
-            break;
+            return makeToken(match('>') ? TokenType::ARROW : TokenType::MINUS);
         case '"': return stringLiteral();
         default:
             if (isAlpha(c)) {
@@ -105,65 +276,85 @@ Token Lexer::nextToken() {
             }
     }
 
-    return {TokenType::UNKNOWN, std::string(1, c), line, column};
+    return makeToken(TokenType::UNKNOWN);
 }
 
 Token Lexer::identifier() {
-    while (isAlphaNumeric(peek())) {
-        advance();
-    }
-    std::string text = source.substr(start, current - start);
-    auto it = keywords.find(text);
-    if (it != keywords.end()) {
-        return {it->second, text, line, column};
+    size_t n = runLength<IdentifierClass>(source.data() + current, source.data() + source.size());
+    current += n;
+    column += n;
+    std::string_view text = source.substr(start, current - start);
+    if (const Keyword* kw = findKeyword(text)) {
+        return makeToken(kw->type);
     }
-    return {TokenType::IDENTIFIER, text, line, column};
+    Token token = makeToken(TokenType::IDENTIFIER);
+    token.symbol = symbols.intern(text);
+    return token;
+}
+
+void Lexer::skipDigits() {
+    size_t n = runLength<DigitClass>(source.data() + current, source.data() + source.size());
+    current += n;
+    column += n;
 }
 
 Token Lexer::number() {
     bool isFloat = false;
-    while (isDigit(peek())) {
-        advance();
-    }
+    skipDigits();
     if (peek() == '.' && isDigit(peekNext())) {
         isFloat = true;
         advance(); // Consume the '.'
-        while (isDigit(peek())) {
-            advance();
-        }
+        skipDigits();
     }
-    std::string text = source.substr(start, current - start);
-    return {isFloat ? TokenType::FLOAT_LITERAL : TokenType::INT_LITERAL, text, line, column};
+    return makeToken(isFloat ? TokenType::FLOAT_LITERAL : TokenType::INT_LITERAL);
 }
 
 Token Lexer::stringLiteral() {
-    std::string value;
+    // The token covers the quotes; escapes are decoded by unescape() when
+    // the parser builds the literal.
     while (peek() != '"' && !isAtEnd()) {
+        size_t n = runLength<StringBodyClass>(source.data() + current, source.data() + source.size());
+        current += n;
+        column += n;
+        if (peek() == '"' || isAtEnd()) break;
+
         if (peek() == '\\') {
             advance(); // Consume the backslash
-            switch (peek()) {
-                case 'n': value += '\n'; break;
-                case 't': value += '\t'; break;
-                case '\\': value += '\\'; break;
-                case '"': value += '"'; break;
-                default:
-                    // Or just append the character literally
-                    value += peek();
-                    break;
-            }
-        } else {
-            value += peek();
+            if (isAtEnd()) break;
+        }
+        if (peek() == '\n') {
+            line++;
+            column = 0;
         }
         advance();
     }
 
     if (isAtEnd()) {
         // Unterminated string
-        return {TokenType::UNKNOWN, "Unterminated string.", line, column};
+        return makeToken(TokenType::UNKNOWN);
     }
 
     advance(); // The closing "
-    return {TokenType::STRING_LITERAL, value, line, column};
+    return makeToken(TokenType::STRING_LITERAL);
+}
+
+size_t Lexer::unescape(std::string_view raw, char* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c == '\\' && i + 1 < raw.size()) {
+            c = raw[++i];
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                default:
+                    // Or just append the character literally
+                    break;
+            }
+        }
+        out[n++] = c;
+    }
+    return n;
 }
 
 char Lexer::advance() {
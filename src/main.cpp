@@ -1,45 +1,506 @@
 #include "lexer.h"
 #include "parser.h"
 #include "codegen.h"
-#include <fstream>
+#include "constfold.h"
+#include "cache.h"
+#include "callgraph.h"
+#include "timereport.h"
+#include "interface.h"
+#include "target.h"
+#include "thinlto.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
+#include <optional>
+
+// Links object files into an executable through the system C compiler
+// driver, which knows where crt files and libc live.
+// Instrumented programs also pull in the profile writer of the runtime.
+static bool linkExecutable(const std::vector<std::string>& objFiles, const std::string& exeFile, bool profileRuntime) {
+    auto driver = llvm::sys::findProgramByName("cc");
+    if (!driver) {
+        std::cerr << "Could not find a linker driver (cc) in PATH.\n";
+        return false;
+    }
+
+    llvm::SmallVector<llvm::StringRef, 8> args = {*driver};
+    args.append(objFiles.begin(), objFiles.end());
+    args.push_back(CAT_RUNTIME_LIBRARY);
+    if (profileRuntime) {
+        args.push_back("-Wl,-u,__llvm_profile_runtime");
+    }
+    args.append({"-o", exeFile});
+    std::string errMsg;
+    int rc = llvm::sys::ExecuteAndWait(*driver, args, llvm::None, {}, 0, 0, &errMsg);
+    if (rc != 0) {
+        std::cerr << "Linking failed" << (errMsg.empty() ? "" : ": " + errMsg) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Everything needed to compile one input file. Units only share read-only
+// prototypes, so each owns its symbols, AST and LLVM context and can be
+// compiled on its own thread.
+struct CompileUnit {
+    std::string path;
+    std::string output; // Written by the worker when non-empty
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    SymbolTable symbols;
+    std::unique_ptr<ModuleAST> ast;
+    std::unique_ptr<CodeGen> codegen;
+    llvm::SmallVector<char, 0> bitcode; // ThinLTO input, with --lto=thin
+    bool ok = false;
+};
+
+static bool parseUnit(CompileUnit& unit, TimeReport* report) {
+    {
+        // Regular files are memory-mapped and lexed in place; stdin ("-")
+        // and pipes fall back to a plain read.
+        TimeReport::Scope timer(report, "read");
+        auto file = llvm::MemoryBuffer::getFileOrSTDIN(unit.path, false, false);
+        if (!file) {
+            std::cerr << "Failed to open file: " << unit.path << ": " << file.getError().message() << "\n";
+            return false;
+        }
+        unit.buffer = std::move(*file);
+    }
+    std::string_view source(unit.buffer->getBufferStart(), unit.buffer->getBufferSize());
+
+    {
+        // Tokens are pulled from the lexer on demand by the parser, so
+        // lexing is timed as part of parsing.
+        TimeReport::Scope timer(report, "lex_parse");
+        Lexer lexer(source, unit.symbols);
+        Parser parser(lexer);
+        unit.ast = parser.parse();
+        if (!unit.ast) {
+            std::cerr << unit.path << ": Parsing failed.\n";
+            return false;
+        }
+        if (report) {
+            report->addCount("source_bytes", source.size());
+            report->addCount("tokens", lexer.tokenCount());
+            report->addCount("ast_nodes", unit.ast->Nodes.objectCount());
+        }
+    }
+
+    TimeReport::Scope timer(report, "fold");
+    ConstantFolder folder;
+    folder.run(*unit.ast);
+    if (report) {
+        report->addCount("folded_expressions", folder.foldedExpressions());
+        report->addCount("removed_statements", folder.removedStatements());
+    }
+    return true;
+}
+
+static bool writeOutput(CodeGen& codegen, const std::string& emitKind, const std::string& outFile, TimeReport* report) {
+    TimeReport::Scope timer(report, "emit");
+    bool ok = emitKind == "ll"   ? codegen.writeToFile(outFile)
+              : emitKind == "bc" ? codegen.writeBitcodeFile(outFile, outFile)
+                                 : codegen.emitNativeFile(outFile, emitKind == "asm");
+    if (!ok) {
+        std::cerr << "Failed to write " << outFile << ".\n";
+    }
+    return ok;
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>\n";
+    std::vector<std::string> inputs;
+    std::string outputFile;
+    unsigned optLevel = 0;
+    unsigned jobs = 1;
+    bool timePasses = false;
+    bool runMode = false;
+    std::string emitKind = "ll";
+    std::string interfaceFile;
+    std::vector<std::string> imports;
+    std::vector<std::string> programArgs;
+    std::string cacheDir;
+    uint64_t cacheSizeMB = 512;
+    bool timeReportTable = false;
+    std::string timeReportJSON;
+    bool wholeProgram = false;
+    std::vector<std::string> exports;
+    bool thinLTO = false;
+    TargetSpec target;
+    bool profileGenerate = false;
+    std::string profileFile; // raw profile to write, or indexed profile to use
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() == 3 && arg.compare(0, 2, "-O") == 0 && arg[2] >= '0' && arg[2] <= '3') {
+            optLevel = arg[2] - '0';
+        } else if (arg.compare(0, 2, "-j") == 0) {
+            std::string value = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            jobs = std::atoi(value.c_str());
+            if (jobs == 0) {
+                std::cerr << "Invalid job count: " << value << "\n";
+                return 1;
+            }
+        } else if (arg.compare(0, 2, "-o") == 0) {
+            outputFile = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            if (outputFile.empty()) {
+                std::cerr << "Missing output file after -o\n";
+                return 1;
+            }
+        } else if (arg == "--time-passes") {
+            timePasses = true;
+        } else if (arg == "--time-report") {
+            timeReportTable = true;
+        } else if (arg.compare(0, 19, "--time-report-json=") == 0) {
+            timeReportJSON = arg.substr(19);
+        } else if (arg.compare(0, 7, "--emit=") == 0) {
+            emitKind = arg.substr(7);
+            if (emitKind != "ll" && emitKind != "bc" && emitKind != "obj" && emitKind != "asm" && emitKind != "exe") {
+                std::cerr << "Unknown emit kind: " << emitKind << "\n";
+                return 1;
+            }
+        } else if (arg.compare(0, 17, "--emit-interface=") == 0) {
+            interfaceFile = arg.substr(17);
+        } else if (arg.compare(0, 9, "--import=") == 0) {
+            imports.push_back(arg.substr(9));
+        } else if (arg.compare(0, 12, "--cache-dir=") == 0) {
+            cacheDir = arg.substr(12);
+        } else if (arg.compare(0, 13, "--cache-size=") == 0) {
+            cacheSizeMB = std::strtoull(arg.c_str() + 13, nullptr, 10);
+            if (cacheSizeMB == 0) {
+                std::cerr << "Invalid cache size: " << arg.substr(13) << "\n";
+                return 1;
+            }
+        } else if (arg == "--whole-program") {
+            wholeProgram = true;
+        } else if (arg.compare(0, 9, "--export=") == 0) {
+            exports.push_back(arg.substr(9));
+        } else if (arg == "--lto=thin") {
+            thinLTO = true;
+        } else if (arg.compare(0, 7, "-march=") == 0) {
+            target.setCPU(arg.substr(7));
+        } else if (arg.compare(0, 6, "-mcpu=") == 0) {
+            target.setCPU(arg.substr(6));
+        } else if (arg.compare(0, 7, "-mattr=") == 0) {
+            target.addFeatures(arg.substr(7));
+        } else if (arg == "--profile-generate" || arg.compare(0, 19, "--profile-generate=") == 0) {
+            profileGenerate = true;
+            profileFile = arg.size() > 19 ? arg.substr(19) : "";
+        } else if (arg.compare(0, 14, "--profile-use=") == 0) {
+            profileFile = arg.substr(14);
+        } else if (arg == "--run") {
+            runMode = true;
+        } else if (arg == "--") {
+            // Everything after "--" belongs to the program run by --run.
+            programArgs.assign(argv + i + 1, argv + argc);
+            break;
+        } else if (arg[0] != '-' || arg == "-") {
+            inputs.push_back(arg);
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-O0|-O1|-O2|-O3] [-j N] [-o file] [--time-passes] [--time-report] [--time-report-json=file] [--emit=ll|bc|obj|asm|exe] [--emit-interface=file.cati] [--import=file.cati]... [--cache-dir=dir] [--cache-size=MB] [--whole-program] [--export=name]... [--lto=thin] [-march=native|cpu] [-mcpu=cpu] [-mattr=+feature,-feature] [--profile-generate[=file]] [--profile-use=file.profdata] [--run] <filename|->... [-- args...]\n";
+        return 1;
+    }
+    if (std::count(inputs.begin(), inputs.end(), "-") > 1) {
+        std::cerr << "stdin can only be read once.\n";
+        return 1;
+    }
+    if (!interfaceFile.empty() && inputs.size() > 1) {
+        std::cerr << "--emit-interface needs a single input file.\n";
         return 1;
     }
 
-    std::ifstream file(argv[1]);
-    if (!file) {
-        std::cerr << "Failed to open file: " << argv[1] << "\n";
+    if (thinLTO && (runMode || emitKind != "exe")) {
+        std::cerr << "--lto=thin needs --emit=exe.\n";
+        return 1;
+    }
+    if (!target.validate()) {
         return 1;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
+    // Profiles change the optimized IR without changing the source, which
+    // the function cache can't see.
+    std::optional<llvm::PGOOptions> pgo;
+    if (profileGenerate) {
+        if (runMode) {
+            std::cerr << "--profile-generate needs a linked program, not --run.\n";
+            return 1;
+        }
+        pgo = llvm::PGOOptions(profileFile, "", "", llvm::PGOOptions::IRInstr);
+    } else if (!profileFile.empty()) {
+        if (!llvm::sys::fs::exists(profileFile)) {
+            std::cerr << "Profile not found: " << profileFile << "\n";
+            return 1;
+        }
+        pgo = llvm::PGOOptions(profileFile, "", "", llvm::PGOOptions::IRUse);
+    }
+    if (pgo && !cacheDir.empty()) {
+        std::cerr << "--cache-dir can't be combined with --profile-generate or --profile-use.\n";
+        return 1;
+    }
 
-    // 1. Lexer
-    Lexer lexer(source);
-    std::vector<Token> tokens = lexer.tokenize();
+    std::vector<std::unique_ptr<CompileUnit>> units;
+    for (const auto& input : inputs) {
+        units.push_back(std::make_unique<CompileUnit>());
+        units.back()->path = input;
+    }
 
-    // 2. Parser
-    Parser parser(tokens);
-    std::unique_ptr<ModuleAST> ast = parser.parse();
-    if (!ast) {
-        std::cerr << "Parsing failed.\n";
-        return 1;
+    // A single input keeps the fixed output names unless -o is given. Several
+    // inputs get one file each, named after the input, or are linked into
+    // the -o file. Executables link one object per input, or per ThinLTO
+    // backend task.
+    std::string ext = emitKind == "ll"    ? ".ll"
+                      : emitKind == "bc"  ? ".bc"
+                      : emitKind == "obj" ? ".o"
+                      : emitKind == "asm" ? ".s"
+                                          : "";
+    bool linkUnits = runMode || (units.size() > 1 && !outputFile.empty() && emitKind != "exe");
+    if (thinLTO) {
+        // Units keep their bitcode in memory for the link step.
+    } else if (!runMode && emitKind == "exe") {
+        for (auto& unit : units) {
+            llvm::SmallString<128> objFile;
+            if (llvm::sys::fs::createTemporaryFile("cat", "o", objFile)) {
+                std::cerr << "Failed to create temporary object file.\n";
+                return 1;
+            }
+            unit->output = std::string(objFile);
+        }
+    } else if (!linkUnits) {
+        for (auto& unit : units) {
+            if (units.size() == 1) {
+                unit->output = outputFile.empty() ? "output" + ext : outputFile;
+            } else {
+                std::string stem = unit->path == "-" ? "stdin" : llvm::sys::path::stem(unit->path).str();
+                unit->output = stem + ext;
+            }
+        }
+        // Inputs with the same stem would be written by two threads at once.
+        llvm::StringMap<const std::string*> written;
+        for (auto& unit : units) {
+            auto [it, inserted] = written.try_emplace(unit->output, &unit->path);
+            if (!inserted) {
+                std::cerr << *it->second << " and " << unit->path << " would both be written to " << unit->output
+                          << "; pass -o to link them into one file.\n";
+                return 1;
+            }
+        }
     }
 
-    // 3. Code Generation
-    CodeGen codegen;
-    codegen.generate(*ast);
-    if (!codegen.writeToFile("output.ll")) {
-        std::cerr << "Failed to write LLVM IR to file.\n";
+    std::unique_ptr<TimeReport> report;
+    if (timeReportTable || !timeReportJSON.empty()) {
+        report = std::make_unique<TimeReport>();
+    }
+
+    // Pass timings are collected in global state, so keep to one thread then.
+    unsigned poolSize = timePasses ? 1 : std::min<size_t>(jobs, units.size());
+    llvm::ThreadPool pool(llvm::hardware_concurrency(poolSize));
+
+    // 1. Lex and parse every input
+    for (auto& unit : units) {
+        pool.async([&unit, &report] { unit->ok = parseUnit(*unit, report.get()); });
+    }
+    pool.wait();
+    for (auto& unit : units) {
+        if (!unit->ok) {
+            return 1;
+        }
+    }
+
+    if (!interfaceFile.empty() && !ModuleInterface::write(*units[0]->ast, interfaceFile)) {
+        std::cerr << "Failed to write module interface.\n";
         return 1;
     }
 
-    return 0;
-}
\ No newline at end of file
+    // Imported prototypes only provide names and types, so one copy is
+    // shared read-only by every unit.
+    SymbolTable importSymbols;
+    Arena importArena;
+    std::vector<PrototypeAST*> importedProtos;
+    for (const auto& import : imports) {
+        if (!ModuleInterface::read(import, importArena, importSymbols, importedProtos)) {
+            return 1;
+        }
+    }
+
+    // In whole-program mode the inputs are the entire program: functions
+    // main and the exports can't reach are dropped and the rest are
+    // internalized wherever no other input calls them.
+    std::unique_ptr<ProgramLinkage> linkage;
+    if (wholeProgram) {
+        CallGraph graph;
+        for (size_t i = 0; i < units.size(); ++i) {
+            graph.addModule(*units[i]->ast, i);
+        }
+        linkage = std::make_unique<ProgramLinkage>(graph.link(exports));
+        for (const auto& name : exports) {
+            if (!linkage->defined.count(name)) {
+                std::cerr << "Exported function is not defined: " << name << "\n";
+                return 1;
+            }
+        }
+        if (linkage->live.empty()) {
+            std::cerr << "--whole-program needs a main function or --export.\n";
+            return 1;
+        }
+    }
+
+    std::unique_ptr<FunctionCache> cache;
+    if (!cacheDir.empty()) {
+        cache = std::make_unique<FunctionCache>(cacheDir, cacheSizeMB << 20);
+        if (!cache->open()) {
+            return 1;
+        }
+    }
+
+    // 2. Generate, optimize and write each unit. Calls into other inputs are
+    // resolved by declaring their prototypes; with a single input the jobs go
+    // to per-function code generation instead.
+    unsigned functionJobs = units.size() == 1 ? jobs : 1;
+    for (auto& unit : units) {
+        pool.async([&, functionJobs] {
+            unit->codegen = std::make_unique<CodeGen>(target);
+            CodeGen& codegen = *unit->codegen;
+            codegen.setTimeReport(report.get());
+            codegen.setLinkage(linkage.get());
+            if (pgo) {
+                codegen.setProfile(*pgo);
+            }
+            for (auto* proto : importedProtos) {
+                codegen.declare(*proto);
+            }
+            for (auto& other : units) {
+                if (other == unit) {
+                    continue;
+                }
+                for (auto* func : other->ast->Functions) {
+                    codegen.declare(*func->Proto);
+                }
+            }
+
+            // Cached functions arrive optimized one at a time, so they only
+            // need inlining across each other here, and nothing at all ahead
+            // of a ThinLTO link, whose backends inline across every input.
+            bool generated = true;
+            {
+                TimeReport::Scope timer(report.get(), "codegen");
+                if (cache) {
+                    generated = codegen.generateCached(*unit->ast, *cache, optLevel, functionJobs);
+                } else {
+                    codegen.generate(*unit->ast, functionJobs);
+                }
+            }
+            if (report) {
+                report->addCount("ir_instructions", codegen.instructionCount());
+            }
+            auto pipeline = thinLTO ? CodeGen::Pipeline::ThinLTOPreLink
+                            : cache ? CodeGen::Pipeline::CachedLink
+                                    : CodeGen::Pipeline::PerModule;
+            unsigned level = cache && thinLTO ? 0 : optLevel;
+            unit->ok = generated && codegen.optimize(level, timePasses, pipeline);
+            if (report) {
+                report->addCount("ir_instructions_optimized", codegen.instructionCount());
+            }
+            if (!unit->ok) {
+                std::cerr << unit->path << ": Optimization failed.\n";
+            } else if (thinLTO) {
+                TimeReport::Scope timer(report.get(), "emit");
+                llvm::raw_svector_ostream os(unit->bitcode);
+                codegen.writeThinLTOBitcode(os, unit->path);
+            } else if (!unit->output.empty()) {
+                unit->ok = writeOutput(codegen, emitKind == "exe" ? "obj" : emitKind, unit->output, report.get());
+            }
+        });
+    }
+    pool.wait();
+
+    if (cache) {
+        std::cerr << "Cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+        cache->prune();
+    }
+
+    bool ok = std::all_of(units.begin(), units.end(), [](const auto& unit) { return unit->ok; });
+    int exitCode = 0;
+    if (ok && linkUnits) {
+        CodeGen& linked = *units[0]->codegen;
+        {
+            TimeReport::Scope timer(report.get(), "link");
+            for (size_t i = 1; ok && i < units.size(); ++i) {
+                ok = linked.link(*units[i]->codegen);
+            }
+        }
+
+        // 3. Either execute in-process or write the linked result
+        if (ok && runMode) {
+            TimeReport::Scope timer(report.get(), "jit_run");
+            if (!linked.runJIT(inputs[0], programArgs, exitCode)) {
+                std::cerr << "JIT execution failed.\n";
+                ok = false;
+            }
+        } else {
+            ok = ok && writeOutput(linked, emitKind, outputFile, report.get());
+        }
+    }
+
+    if (emitKind == "exe" && !runMode) {
+        std::vector<std::string> objFiles;
+        if (thinLTO) {
+            // Only main, the exports and the profile variables stay visible
+            // to the native link.
+            TimeReport::Scope timer(report.get(), "lto");
+            llvm::StringSet<> preserved;
+            preserved.insert("main");
+            for (const auto& name : exports) {
+                preserved.insert(name);
+            }
+            if (profileGenerate) {
+                // Read by the profile writer in the runtime
+                preserved.insert("__llvm_profile_raw_version");
+                preserved.insert("__llvm_profile_filename");
+            }
+            ThinLTOLink lto(optLevel, jobs, std::move(preserved), target);
+            for (auto& unit : units) {
+                ok = ok && lto.add(unit->path, std::move(unit->bitcode));
+            }
+            ok = ok && lto.run(objFiles);
+        } else {
+            for (auto& unit : units) {
+                objFiles.push_back(unit->output);
+            }
+        }
+        {
+            TimeReport::Scope timer(report.get(), "link");
+            ok = ok && linkExecutable(objFiles, outputFile.empty() ? "output" : outputFile, profileGenerate);
+        }
+        for (const auto& objFile : objFiles) {
+            llvm::sys::fs::remove(objFile);
+        }
+    }
+
+    if (timeReportTable) {
+        report->printTable(llvm::errs());
+    }
+    if (!timeReportJSON.empty()) {
+        std::error_code EC;
+        llvm::raw_fd_ostream out(timeReportJSON, EC, llvm::sys::fs::OF_Text);
+        if (EC) {
+            std::cerr << "Could not open file: " << timeReportJSON << ": " << EC.message() << "\n";
+            return 1;
+        }
+        report->printJSON(out);
+    }
+
+    if (!ok) {
+        return 1;
+    }
+    return exitCode;
+}
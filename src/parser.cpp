@@ -1,48 +1,83 @@
 #include "parser.h"
-#include <map>
-
-static std::map<TokenType, int> BinopPrecedence;
-
-static void initializePrecedence() {
-    BinopPrecedence[TokenType::LESS] = 10;
-    BinopPrecedence[TokenType::EQUAL_EQUAL] = 10;
-    BinopPrecedence[TokenType::BANG_EQUAL] = 10;
-    BinopPrecedence[TokenType::LESS_EQUAL] = 10;
-    BinopPrecedence[TokenType::GREATER_EQUAL] = 10;
-    BinopPrecedence[TokenType::PLUS] = 20;
-    BinopPrecedence[TokenType::AMPERSAND_AMPERSAND] = 5;
-    BinopPrecedence[TokenType::PIPE_PIPE] = 5;
+#include <cassert>
+#include <charconv>
+
+struct BinopInfo {
+    int precedence; // -1 if the token is not a binary operator
+    BinaryOp op;
+};
+
+static constexpr BinopInfo binopInfo(TokenType type) {
+    switch (type) {
+        case TokenType::PIPE_PIPE: return {4, BinaryOp::Or};
+        case TokenType::AMPERSAND_AMPERSAND: return {5, BinaryOp::And};
+        case TokenType::EQUAL_EQUAL: return {10, BinaryOp::Equal};
+        case TokenType::BANG_EQUAL: return {10, BinaryOp::NotEqual};
+        case TokenType::LESS: return {10, BinaryOp::Less};
+        case TokenType::GT: return {10, BinaryOp::Greater};
+        case TokenType::LESS_EQUAL: return {10, BinaryOp::LessEqual};
+        case TokenType::GREATER_EQUAL: return {10, BinaryOp::GreaterEqual};
+        case TokenType::PLUS: return {20, BinaryOp::Add};
+        case TokenType::MINUS: return {20, BinaryOp::Sub};
+        case TokenType::STAR: return {30, BinaryOp::Mul};
+        case TokenType::SLASH: return {30, BinaryOp::Div};
+        default: return {-1, BinaryOp::Add};
+    }
 }
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {
-    initializePrecedence();
-}
+Parser::Parser(Lexer& lexer) : lexer(lexer) {}
 
 std::unique_ptr<ModuleAST> Parser::parse() {
     auto module = std::make_unique<ModuleAST>();
-    while (current < tokens.size() && tokens[current].type != TokenType::END_OF_FILE) {
+    arena = &module->Nodes;
+    while (!check(TokenType::END_OF_FILE)) {
         if (auto f = parseDefinition()) {
-            module->Functions.push_back(std::move(f));
+            module->Functions.push_back(f);
         } else {
             // Skip to the next token to avoid infinite loops on errors
             advance();
         }
     }
+    arena = nullptr;
     return module;
 }
 
-Token& Parser::currentToken() {
-    return tokens[current];
+template <typename T>
+std::span<T> Parser::takeScratch(std::vector<T>& scratch, size_t start) {
+    std::span<T> items = arena->copyArray(std::span<const T>(scratch.data() + start, scratch.size() - start));
+    scratch.resize(start);
+    return items;
+}
+
+const Token& Parser::currentToken() {
+    return peekToken(0);
+}
+
+const Token& Parser::peekToken(size_t n) {
+    assert(n < MaxLookahead && "lookahead exceeds the token ring");
+    while (buffered <= n) {
+        lookahead[(head + buffered) % MaxLookahead] = lexer.next();
+        buffered++;
+    }
+    return lookahead[(head + n) % MaxLookahead];
+}
+
+std::string_view Parser::tokenText(const Token& token) {
+    return lexer.text(token);
+}
+
+Symbol Parser::tokenSymbol(const Token& token) {
+    return lexer.symbolTable().get(token.symbol);
 }
 
 void Parser::advance() {
-    if (current < tokens.size() - 1) {
-        current++;
+    if (currentToken().type != TokenType::END_OF_FILE) {
+        head = (head + 1) % MaxLookahead;
+        buffered--;
     }
 }
 
 bool Parser::check(TokenType type) {
-    if (current >= tokens.size()) return false;
     return currentToken().type == type;
 }
 
@@ -55,53 +90,89 @@ bool Parser::match(TokenType type) {
 }
 
 bool Parser::isType() {
-    return check(TokenType::INT_TYPE) || check(TokenType::FLOAT_TYPE) || check(TokenType::STRING_TYPE) || check(TokenType::BOOL_TYPE);
+    return check(TokenType::INT_TYPE) || check(TokenType::FLOAT_TYPE) || check(TokenType::STRING_TYPE) ||
+           check(TokenType::BOOL_TYPE) || check(TokenType::VECTOR_TYPE);
 }
 
-int Parser::getTokPrecedence() {
-    if (BinopPrecedence.count(currentToken().type)) {
-        return BinopPrecedence[currentToken().type];
+// Static spelling of a type token; vector types share one token type.
+std::string_view Parser::typeName(const Token& token) {
+    if (token.type == TokenType::VECTOR_TYPE) {
+        return vectorTypeName(tokenText(token));
     }
-    return -1;
+    return tokenSpelling(token.type);
+}
+
+int Parser::getTokPrecedence() {
+    return binopInfo(currentToken().type).precedence;
 }
 
-std::unique_ptr<Expr> Parser::parseIdentifierExpr() {
-    std::string idName = currentToken().value;
+Expr* Parser::parseIdentifierExpr() {
+    Symbol idName = tokenSymbol(currentToken());
     advance(); // consume identifier.
 
-    if (!match(TokenType::LPAREN)) // Simple variable ref.
-        return std::make_unique<VariableExpr>(idName);
+    if (!match(TokenType::LPAREN)) { // Simple variable ref or array element.
+        auto* var = arena->make<VariableExpr>(idName);
+        if (!match(TokenType::LBRACKET)) {
+            return var;
+        }
+        auto index = parseExpression();
+        if (!index || !match(TokenType::RBRACKET)) return nullptr;
+        return arena->make<IndexExpr>(var, index);
+    }
 
     // Call.
-    std::vector<std::unique_ptr<Expr>> args;
+    size_t argsStart = exprScratch.size();
     if (!check(TokenType::RPAREN)) {
         do {
-            if (auto arg = parseExpression())
-                args.push_back(std::move(arg));
-            else
+            if (auto arg = parseExpression()) {
+                exprScratch.push_back(arg);
+            } else {
+                exprScratch.resize(argsStart);
                 return nullptr;
+            }
         } while (match(TokenType::COMMA));
     }
 
-    if (!match(TokenType::RPAREN))
+    if (!match(TokenType::RPAREN)) {
+        exprScratch.resize(argsStart);
         return nullptr; // Expected ')'
+    }
 
-    return std::make_unique<CallExpr>(idName, std::move(args));
+    return arena->make<CallExpr>(idName, takeScratch(exprScratch, argsStart));
 }
 
-std::unique_ptr<Expr> Parser::parseNumberExpr() {
-    auto result = std::make_unique<NumberExpr>(currentToken().value, currentToken().type);
+Expr* Parser::parseNumberExpr() {
+    std::string_view text = tokenText(currentToken());
+    const char* end = text.data() + text.size();
+    Expr* result;
+    if (currentToken().type == TokenType::INT_LITERAL) {
+        // Cat ints are i32; wider literals wrap around like the constant did.
+        int64_t value;
+        if (std::from_chars(text.data(), end, value).ec != std::errc()) {
+            return nullptr; // literal out of range
+        }
+        result = arena->make<NumberExpr>(static_cast<int32_t>(value));
+    } else {
+        float value;
+        if (std::from_chars(text.data(), end, value).ec != std::errc()) {
+            return nullptr; // literal out of range
+        }
+        result = arena->make<NumberExpr>(value);
+    }
     advance(); // consume the number
-    return std::move(result);
+    return result;
 }
 
-std::unique_ptr<Expr> Parser::parseStringExpr() {
-    auto result = std::make_unique<StringExpr>(currentToken().value);
+Expr* Parser::parseStringExpr() {
+    std::string_view raw = tokenText(currentToken());
+    raw = raw.substr(1, raw.size() - 2); // strip the quotes
+    char* value = static_cast<char*>(arena->allocate(raw.size(), 1));
+    auto* result = arena->make<StringExpr>(std::string_view(value, Lexer::unescape(raw, value)));
     advance(); // consume the string
-    return std::move(result);
+    return result;
 }
 
-std::unique_ptr<Expr> Parser::parseParenExpr() {
+Expr* Parser::parseParenExpr() {
     advance(); // eat '('.
     auto V = parseExpression();
     if (!V)
@@ -112,43 +183,66 @@ std::unique_ptr<Expr> Parser::parseParenExpr() {
     return V;
 }
 
-std::unique_ptr<Expr> Parser::parseBoolExpr() {
-    bool value = currentToken().value == "true";
+Expr* Parser::parseBoolExpr() {
+    bool value = tokenText(currentToken()) == "true";
     advance(); // consume the boolean
-    return std::make_unique<BoolExpr>(value);
+    return arena->make<BoolExpr>(value);
+}
+
+Expr* Parser::parseVectorExpr() {
+    std::string_view type = typeName(currentToken());
+    advance(); // consume the type
+    if (!match(TokenType::LPAREN)) return nullptr;
+
+    size_t lanesStart = exprScratch.size();
+    do {
+        if (auto lane = parseExpression()) {
+            exprScratch.push_back(lane);
+        } else {
+            exprScratch.resize(lanesStart);
+            return nullptr;
+        }
+    } while (match(TokenType::COMMA));
+
+    if (!match(TokenType::RPAREN)) {
+        exprScratch.resize(lanesStart);
+        return nullptr;
+    }
+    return arena->make<VectorExpr>(type, takeScratch(exprScratch, lanesStart));
 }
 
-std::unique_ptr<Expr> Parser::parsePrimary() {
+Expr* Parser::parsePrimary() {
     if (check(TokenType::IDENTIFIER)) return parseIdentifierExpr();
     if (check(TokenType::INT_LITERAL) || check(TokenType::FLOAT_LITERAL)) return parseNumberExpr();
     if (check(TokenType::STRING_LITERAL)) return parseStringExpr();
     if (check(TokenType::BOOL_LITERAL)) return parseBoolExpr();
     if (check(TokenType::LPAREN)) return parseParenExpr();
+    if (check(TokenType::VECTOR_TYPE)) return parseVectorExpr();
     return nullptr;
 }
 
-std::unique_ptr<Expr> Parser::parseUnary() {
-    if (!check(TokenType::BANG)) {
+Expr* Parser::parseUnary() {
+    if (!check(TokenType::BANG) && !check(TokenType::MINUS)) {
         return parsePrimary();
     }
 
-    std::string op = currentToken().value;
+    UnaryOp op = check(TokenType::BANG) ? UnaryOp::Not : UnaryOp::Neg;
     advance(); // eat operator
 
     auto operand = parseUnary();
     if (!operand) return nullptr;
 
-    return std::make_unique<UnaryExpr>(op, std::move(operand));
+    return arena->make<UnaryExpr>(op, operand);
 }
 
-std::unique_ptr<Expr> Parser::parseBinOpRHS(int exprPrec, std::unique_ptr<Expr> LHS) {
+Expr* Parser::parseBinOpRHS(int exprPrec, Expr* LHS) {
     while (true) {
         int tokPrec = getTokPrecedence();
 
         if (tokPrec < exprPrec)
             return LHS;
 
-        std::string binOp = currentToken().value;
+        BinaryOp binOp = binopInfo(currentToken().type).op;
         advance(); // eat binop
 
         auto RHS = parseUnary();
@@ -157,81 +251,106 @@ std::unique_ptr<Expr> Parser::parseBinOpRHS(int exprPrec, std::unique_ptr<Expr>
 
         int nextPrec = getTokPrecedence();
         if (tokPrec < nextPrec) {
-            RHS = parseBinOpRHS(tokPrec + 1, std::move(RHS));
+            RHS = parseBinOpRHS(tokPrec + 1, RHS);
             if (!RHS)
                 return nullptr;
         }
 
-        LHS = std::make_unique<BinaryExpr>(binOp, std::move(LHS), std::move(RHS));
+        LHS = arena->make<BinaryExpr>(binOp, LHS, RHS);
     }
 }
 
-std::unique_ptr<Expr> Parser::parseExpression() {
+Expr* Parser::parseExpression() {
     auto LHS = parseUnary();
     if (!LHS)
         return nullptr;
 
-    return parseBinOpRHS(0, std::move(LHS));
+    return parseBinOpRHS(0, LHS);
 }
 
-std::unique_ptr<Stmt> Parser::parseReturnStmt() {
+Stmt* Parser::parseReturnStmt() {
     advance(); // consume 'return'
     auto value = parseExpression();
     if (!value) return nullptr;
     if (!match(TokenType::SEMICOLON)) return nullptr;
-    return std::make_unique<ReturnStmt>(std::move(value));
+    return arena->make<ReturnStmt>(value);
 }
 
-std::unique_ptr<Stmt> Parser::parsePrintStmt() {
+Stmt* Parser::parsePrintStmt() {
     advance(); // consume 'print'
     if (!match(TokenType::LPAREN)) return nullptr;
 
     auto formatExpr = parseExpression();
     if (!formatExpr) return nullptr;
 
-    std::vector<std::unique_ptr<Expr>> args;
+    size_t argsStart = exprScratch.size();
     while (match(TokenType::COMMA)) {
         auto arg = parseExpression();
-        if (!arg) return nullptr;
-        args.push_back(std::move(arg));
+        if (!arg) {
+            exprScratch.resize(argsStart);
+            return nullptr;
+        }
+        exprScratch.push_back(arg);
     }
 
-    if (!match(TokenType::RPAREN)) return nullptr;
-    if (!match(TokenType::SEMICOLON)) return nullptr;
+    if (!match(TokenType::RPAREN) || !match(TokenType::SEMICOLON)) {
+        exprScratch.resize(argsStart);
+        return nullptr;
+    }
 
-    return std::make_unique<PrintStmt>(std::move(formatExpr), std::move(args));
+    return arena->make<PrintStmt>(formatExpr, takeScratch(exprScratch, argsStart));
 }
 
-std::unique_ptr<Stmt> Parser::parseScanStmt() {
+Stmt* Parser::parseScanStmt() {
     advance(); // consume 'scan'
     if (!match(TokenType::LPAREN)) return nullptr;
     if (!check(TokenType::IDENTIFIER)) return nullptr;
-    auto var = std::make_unique<VariableExpr>(currentToken().value);
+    auto* var = arena->make<VariableExpr>(tokenSymbol(currentToken()));
     advance();
     if (!match(TokenType::RPAREN)) return nullptr;
     if (!match(TokenType::SEMICOLON)) return nullptr;
-    return std::make_unique<ScanStmt>(std::move(var));
+    return arena->make<ScanStmt>(var);
 }
 
-std::unique_ptr<Stmt> Parser::parseVarDeclStmt() {
-    std::string type = currentToken().value;
+Stmt* Parser::parseVarDeclStmt() {
+    std::string_view type = typeName(currentToken());
     advance(); // consume type
 
+    // Arrays: type[count] name;
+    Expr* arraySize = nullptr;
+    if (match(TokenType::LBRACKET)) {
+        if (arrayTypeName(type).empty()) return nullptr;
+        arraySize = parseExpression();
+        if (!arraySize || !match(TokenType::RBRACKET)) return nullptr;
+    }
+
     if (!check(TokenType::IDENTIFIER)) return nullptr;
-    std::string name = currentToken().value;
+    Symbol name = tokenSymbol(currentToken());
     advance();
 
-    std::unique_ptr<Expr> init = nullptr;
-    if (match(TokenType::ASSIGN)) {
+    Expr* init = nullptr;
+    if (!arraySize && match(TokenType::ASSIGN)) {
         init = parseExpression();
         if (!init) return nullptr;
     }
 
     if (!match(TokenType::SEMICOLON)) return nullptr;
-    return std::make_unique<VarDeclStmt>(type, name, std::move(init));
+    return arena->make<VarDeclStmt>(type, name, init, arraySize);
 }
 
-std::unique_ptr<Stmt> Parser::parseIfStmt() {
+// Parses `target = value` without the semicolon, which for loop steps
+// don't have.
+Stmt* Parser::parseAssignment() {
+    if (!check(TokenType::IDENTIFIER)) return nullptr;
+    auto target = parseIdentifierExpr();
+    if (!target || target->Kind == ExprKind::Call) return nullptr;
+    if (!match(TokenType::ASSIGN)) return nullptr;
+    auto value = parseExpression();
+    if (!value) return nullptr;
+    return arena->make<AssignStmt>(target, value);
+}
+
+Stmt* Parser::parseIfStmt() {
     advance(); // consume 'if'
     if (!match(TokenType::LPAREN)) return nullptr;
     auto condition = parseExpression();
@@ -239,15 +358,15 @@ std::unique_ptr<Stmt> Parser::parseIfStmt() {
     if (!match(TokenType::RPAREN)) return nullptr;
     auto thenBranch = parseBlock();
     if (!thenBranch) return nullptr;
-    std::unique_ptr<BlockStmt> elseBranch = nullptr;
+    BlockStmt* elseBranch = nullptr;
     if (match(TokenType::ELSE)) {
         elseBranch = parseBlock();
         if (!elseBranch) return nullptr;
     }
-    return std::make_unique<IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+    return arena->make<IfStmt>(condition, thenBranch, elseBranch);
 }
 
-std::unique_ptr<Stmt> Parser::parseWhileStmt() {
+Stmt* Parser::parseWhileStmt() {
     advance(); // consume 'while'
     if (!match(TokenType::LPAREN)) return nullptr;
     auto condition = parseExpression();
@@ -255,73 +374,122 @@ std::unique_ptr<Stmt> Parser::parseWhileStmt() {
     if (!match(TokenType::RPAREN)) return nullptr;
     auto body = parseBlock();
     if (!body) return nullptr;
-    return std::make_unique<WhileStmt>(std::move(condition), std::move(body));
+    return arena->make<WhileStmt>(condition, body);
 }
 
-std::unique_ptr<Stmt> Parser::parseStatement() {
+Stmt* Parser::parseForStmt() {
+    advance(); // consume 'for'
+    if (!match(TokenType::LPAREN)) return nullptr;
+
+    // The declaration form consumes its own semicolon.
+    Stmt* init = nullptr;
+    if (isType()) {
+        init = parseVarDeclStmt();
+        if (!init) return nullptr;
+    } else {
+        if (!check(TokenType::SEMICOLON)) {
+            init = parseAssignment();
+            if (!init) return nullptr;
+        }
+        if (!match(TokenType::SEMICOLON)) return nullptr;
+    }
+
+    Expr* condition = nullptr;
+    if (!check(TokenType::SEMICOLON)) {
+        condition = parseExpression();
+        if (!condition) return nullptr;
+    }
+    if (!match(TokenType::SEMICOLON)) return nullptr;
+
+    Stmt* step = nullptr;
+    if (!check(TokenType::RPAREN)) {
+        step = parseAssignment();
+        if (!step) return nullptr;
+    }
+    if (!match(TokenType::RPAREN)) return nullptr;
+
+    auto body = parseBlock();
+    if (!body) return nullptr;
+    return arena->make<ForStmt>(init, condition, step, body);
+}
+
+Stmt* Parser::parseStatement() {
     if (check(TokenType::RETURN)) return parseReturnStmt();
     if (check(TokenType::PRINT)) return parsePrintStmt();
     if (check(TokenType::SCAN)) return parseScanStmt();
     if (isType()) return parseVarDeclStmt();
     if (check(TokenType::IF)) return parseIfStmt();
     if (check(TokenType::WHILE)) return parseWhileStmt();
+    if (check(TokenType::FOR)) return parseForStmt();
     if (check(TokenType::IDENTIFIER)) {
-        return std::make_unique<ExprStmt>(parseIdentifierExpr());
+        if (peekToken(1).type == TokenType::ASSIGN || peekToken(1).type == TokenType::LBRACKET) {
+            auto assign = parseAssignment();
+            if (!assign || !match(TokenType::SEMICOLON)) return nullptr;
+            return assign;
+        }
+        return arena->make<ExprStmt>(parseIdentifierExpr());
     }
     return nullptr;
 }
 
-std::unique_ptr<BlockStmt> Parser::parseBlock() {
+BlockStmt* Parser::parseBlock() {
     if (!match(TokenType::LBRACE)) return nullptr;
 
-    auto block = std::make_unique<BlockStmt>();
-    while (!check(TokenType::RBRACE) && current < tokens.size()) {
+    size_t stmtsStart = stmtScratch.size();
+    while (!check(TokenType::RBRACE) && !check(TokenType::END_OF_FILE)) {
         if(auto stmt = parseStatement()) {
-            block->Statements.push_back(std::move(stmt));
+            stmtScratch.push_back(stmt);
         } else {
             // Error, skip the token.
             advance();
         }
     }
 
-    if (!match(TokenType::RBRACE)) return nullptr;
-    return block;
+    if (!match(TokenType::RBRACE)) {
+        stmtScratch.resize(stmtsStart);
+        return nullptr;
+    }
+    return arena->make<BlockStmt>(takeScratch(stmtScratch, stmtsStart));
 }
 
-std::unique_ptr<PrototypeAST> Parser::parsePrototype() {
+PrototypeAST* Parser::parsePrototype() {
     if (!match(TokenType::FN)) return nullptr;
     if (!check(TokenType::IDENTIFIER)) return nullptr;
-    std::string fnName = currentToken().value;
+    Symbol fnName = tokenSymbol(currentToken());
     advance();
 
     if (!match(TokenType::LPAREN)) return nullptr;
-    std::vector<std::pair<std::string, std::string>> argNames;
+    argScratch.clear();
     if (!check(TokenType::RPAREN)) {
         do {
             if (!isType()) return nullptr;
-            std::string argType = currentToken().value;
+            std::string_view argType = typeName(currentToken());
             advance();
+            if (match(TokenType::LBRACKET)) {
+                argType = arrayTypeName(argType);
+                if (argType.empty() || !match(TokenType::RBRACKET)) return nullptr;
+            }
             if (!check(TokenType::IDENTIFIER)) return nullptr;
-            std::string argName = currentToken().value;
+            Symbol argName = tokenSymbol(currentToken());
             advance();
-            argNames.push_back({argType, argName});
+            argScratch.push_back({argType, argName});
         } while (match(TokenType::COMMA));
     }
     if (!match(TokenType::RPAREN)) return nullptr;
 
-    std::string returnType = "void"; // Default return type
+    std::string_view returnType = "void"; // Default return type
     if (match(TokenType::COLON) || match(TokenType::ARROW)) {
         if (!isType()) {
             return nullptr;
         }
-        returnType = currentToken().value;
+        returnType = typeName(currentToken());
         advance();
     }
 
-    return std::make_unique<PrototypeAST>(fnName, std::move(argNames), returnType);
+    return arena->make<PrototypeAST>(fnName, takeScratch(argScratch, 0), returnType);
 }
 
-std::unique_ptr<FunctionAST> Parser::parseDefinition() {
+FunctionAST* Parser::parseDefinition() {
     auto proto = parsePrototype();
     if (!proto) {
         return nullptr;
@@ -332,5 +500,5 @@ std::unique_ptr<FunctionAST> Parser::parseDefinition() {
         return nullptr;
     }
 
-    return std::make_unique<FunctionAST>(std::move(proto), std::move(body));
+    return arena->make<FunctionAST>(proto, body);
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "target.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <memory>
+
+TargetSpec::TargetSpec() : triple(llvm::sys::getDefaultTargetTriple()) {}
+
+void TargetSpec::setCPU(const std::string& name) {
+    if (name != "native") {
+        cpu = name;
+        return;
+    }
+    cpu = llvm::sys::getHostCPUName().str();
+
+    // Sorted so the spelling, and with it cache keys, don't depend on the
+    // order the host reports features in.
+    llvm::StringMap<bool> hostFeatures;
+    if (!llvm::sys::getHostCPUFeatures(hostFeatures)) {
+        return; // the CPU name alone implies its features
+    }
+    std::vector<std::string> flags;
+    for (const auto& feature : hostFeatures) {
+        flags.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+    }
+    std::sort(flags.begin(), flags.end(), [](const std::string& a, const std::string& b) {
+        return a.compare(1, std::string::npos, b, 1, std::string::npos) < 0;
+    });
+    std::string list;
+    for (const auto& flag : flags) {
+        list += (list.empty() ? "" : ",") + flag;
+    }
+    // Host features come first so -mattr can still override them.
+    features = features.empty() ? list : list + "," + features;
+}
+
+void TargetSpec::addFeatures(const std::string& list) {
+    if (!list.empty()) {
+        features += (features.empty() ? "" : ",") + list;
+    }
+}
+
+bool TargetSpec::validate() const {
+    llvm::InitializeNativeTarget();
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        llvm::errs() << "Could not find target " << triple << ": " << error << "\n";
+        return false;
+    }
+    std::unique_ptr<llvm::MCSubtargetInfo> info(target->createMCSubtargetInfo(triple, "", ""));
+    if (cpu != "generic" && !info->isCPUStringValid(cpu)) {
+        llvm::errs() << "Unknown CPU for " << triple << ": " << cpu << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+#include "thinlto.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <mutex>
+
+static llvm::CodeGenOpt::Level codeGenLevel(unsigned optLevel) {
+    switch (optLevel) {
+        case 0: return llvm::CodeGenOpt::None;
+        case 1: return llvm::CodeGenOpt::Less;
+        case 2: return llvm::CodeGenOpt::Default;
+        default: return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+ThinLTOLink::ThinLTOLink(unsigned optLevel, unsigned jobs, llvm::StringSet<> preserved, const TargetSpec& target)
+    : preserved(std::move(preserved)) {
+    // Matches the target machine CodeGen uses for native output.
+    llvm::lto::Config config;
+    config.CPU = target.cpu;
+    llvm::SmallVector<llvm::StringRef, 32> features;
+    llvm::StringRef(target.features).split(features, ',', -1, false);
+    config.MAttrs.assign(features.begin(), features.end());
+    config.RelocModel = llvm::Reloc::PIC_;
+    config.OptLevel = optLevel;
+    config.CGOptLevel = codeGenLevel(optLevel);
+    config.DefaultTriple = target.triple;
+
+    auto backend = llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(jobs));
+    lto = std::make_unique<llvm::lto::LTO>(std::move(config), std::move(backend));
+}
+
+ThinLTOLink::~ThinLTOLink() = default;
+
+bool ThinLTOLink::add(const std::string& name, llvm::SmallVector<char, 0> bitcode) {
+    buffers.push_back(std::make_unique<llvm::SmallVector<char, 0>>(std::move(bitcode)));
+    llvm::MemoryBufferRef ref(llvm::StringRef(buffers.back()->data(), buffers.back()->size()), name);
+    auto input = llvm::lto::InputFile::create(ref);
+    if (!input) {
+        llvm::errs() << name << ": " << llvm::toString(input.takeError()) << "\n";
+        return false;
+    }
+
+    // Every function is defined once in the program; undefined symbols are
+    // either defined by another input or left to the native link. Weak and
+    // comdat definitions, like the version variable of profile
+    // instrumentation, may repeat and the first one prevails.
+    std::vector<llvm::lto::SymbolResolution> resolutions;
+    for (const auto& symbol : (*input)->symbols()) {
+        llvm::lto::SymbolResolution resolution;
+        if (!symbol.isUndefined()) {
+            if (!defined.insert(symbol.getName()).second) {
+                if (symbol.isWeak() || symbol.getComdatIndex() >= 0) {
+                    resolutions.push_back(resolution);
+                    continue;
+                }
+                llvm::errs() << name << ": Duplicate definition of " << symbol.getName() << "\n";
+                return false;
+            }
+            resolution.Prevailing = true;
+            resolution.FinalDefinitionInLinkageUnit = true;
+            resolution.VisibleToRegularObj = preserved.count(symbol.getName()) > 0;
+        }
+        resolutions.push_back(resolution);
+    }
+
+    if (auto error = lto->add(std::move(*input), resolutions)) {
+        llvm::errs() << name << ": " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool ThinLTOLink::run(std::vector<std::string>& objectFiles) {
+    // Tasks that produce nothing never ask for a stream, so objects are
+    // created on demand and collected in task order.
+    std::vector<std::string> taskFiles(lto->getMaxTasks());
+    std::mutex lock;
+    llvm::AddStreamFn addStream = [&](unsigned task) -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        llvm::SmallString<128> path;
+        int fd;
+        if (auto EC = llvm::sys::fs::createTemporaryFile("cat-lto", "o", fd, path)) {
+            return llvm::errorCodeToError(EC);
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            taskFiles[task] = std::string(path);
+        }
+        return std::make_unique<llvm::CachedFileStream>(std::make_unique<llvm::raw_fd_ostream>(fd, true),
+                                                        std::string(path));
+    };
+
+    llvm::Error error = lto->run(addStream);
+    for (auto& file : taskFiles) {
+        if (!file.empty()) {
+            objectFiles.push_back(std::move(file));
+        }
+    }
+    if (error) {
+        llvm::errs() << "ThinLTO link failed: " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+    return true;
+}
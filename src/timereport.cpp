@@ -0,0 +1,107 @@
+#include "timereport.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include <algorithm>
+
+static double toMillis(TimeReport::Clock::duration time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+template <typename T>
+static void accumulate(std::vector<std::pair<std::string, T>>& entries, llvm::StringRef name, T value) {
+    for (auto& entry : entries) {
+        if (entry.first == name) {
+            entry.second += value;
+            return;
+        }
+    }
+    entries.emplace_back(name.str(), value);
+}
+
+void TimeReport::addPhase(llvm::StringRef phase, Clock::duration time) {
+    std::lock_guard<std::mutex> guard(lock);
+    accumulate(phases, phase, time);
+}
+
+void TimeReport::addPass(llvm::StringRef pass, Clock::duration time) {
+    std::lock_guard<std::mutex> guard(lock);
+    PassTime& entry = passes[pass];
+    entry.time += time;
+    ++entry.runs;
+}
+
+void TimeReport::addCount(llvm::StringRef counter, uint64_t value) {
+    std::lock_guard<std::mutex> guard(lock);
+    accumulate(counters, counter, value);
+}
+
+void TimeReport::printTable(llvm::raw_ostream& os) const {
+    std::lock_guard<std::mutex> guard(lock);
+    double total = toMillis(Clock::now() - start);
+
+    os << "===-------------------------------------------------------------------------===\n"
+       << "                           Cat compile time report\n"
+       << "===-------------------------------------------------------------------------===\n"
+       << llvm::format("  Total wall time: %.3f ms\n\n", total)
+       << "  Phase                           Wall (ms)        %\n";
+    for (const auto& [name, time] : phases) {
+        double ms = toMillis(time);
+        os << llvm::format("  %-28s %12.3f %7.1f%%\n", name.c_str(), ms, total > 0 ? 100 * ms / total : 0.0);
+    }
+
+    if (!counters.empty()) {
+        os << "\n  Counter                             Value\n";
+        for (const auto& [name, value] : counters) {
+            os << llvm::format("  %-28s %12llu\n", name.c_str(), (unsigned long long)value);
+        }
+    }
+
+    if (!passes.empty()) {
+        std::vector<const llvm::StringMapEntry<PassTime>*> sorted;
+        for (const auto& entry : passes) {
+            sorted.push_back(&entry);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+            return a->second.time != b->second.time ? a->second.time > b->second.time : a->first() < b->first();
+        });
+        os << "\n  LLVM pass                                           Wall (ms)   Runs\n";
+        for (const auto* entry : sorted) {
+            os << llvm::format("  %-48s %12.3f %6u\n", entry->first().str().c_str(),
+                               toMillis(entry->second.time), entry->second.runs);
+        }
+    }
+    os.flush();
+}
+
+void TimeReport::printJSON(llvm::raw_ostream& os) const {
+    std::lock_guard<std::mutex> guard(lock);
+    llvm::json::OStream json(os, 2);
+    json.object([&] {
+        json.attribute("total_ms", toMillis(Clock::now() - start));
+        json.attributeObject("phases_ms", [&] {
+            for (const auto& [name, time] : phases) {
+                json.attribute(name, toMillis(time));
+            }
+        });
+        json.attributeObject("counters", [&] {
+            for (const auto& [name, value] : counters) {
+                json.attribute(name, static_cast<int64_t>(value));
+            }
+        });
+        json.attributeObject("passes", [&] {
+            std::vector<llvm::StringRef> names;
+            for (const auto& entry : passes) {
+                names.push_back(entry.first());
+            }
+            std::sort(names.begin(), names.end());
+            for (llvm::StringRef name : names) {
+                const PassTime& pass = passes.find(name)->second;
+                json.attributeObject(name, [&] {
+                    json.attribute("ms", toMillis(pass.time));
+                    json.attribute("runs", static_cast<int64_t>(pass.runs));
+                });
+            }
+        });
+    });
+    os << "\n";
+}